@@ -0,0 +1,400 @@
+/**
+ * @file accuracy.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "common.hpp"
+#include "../vulkan-gram-schmidt/host-kernels.hpp"
+#include <exception>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cmath>
+#include <cstdlib>
+
+
+
+
+
+using Matrix = GPUGramSchmidt::Matrix;
+
+
+
+/**
+ * @brief Benchmark settings, see print_usage
+ */
+struct Settings
+{
+	size_t              repetitions = 3;
+	double              budget      = 1.0e-10;
+	std::vector<double> conditions  = {1.0e2, 1.0e6, 1.0e10, 1.0e14};
+	std::vector<size_t> orders;
+};
+
+
+
+/**
+ * @brief Test matrix with its vectors in columns
+ */
+struct TestMatrix
+{
+	std::string family;    // "graded", "hilbert" or "kahan"
+	std::string parameter; // condition number for "graded", angle for "kahan"
+	Matrix      matrix;
+};
+
+
+
+/**
+ * @brief Solver under test
+ */
+struct Solver
+{
+	std::string                                        name;
+	std::function<std::function<void(Matrix &)>(void)> create; // makes the solver, returns the call; may throw if it is not available
+};
+
+
+
+/**
+ * @brief Measurements of one solver on one test matrix
+ */
+struct Result
+{
+	size_t      test_i;
+	std::string solver;
+	double      loss; // ||Q^T Q - I||_F
+	double      time; // best of the repetitions, seconds
+};
+
+
+
+
+
+void print_usage(void)
+{
+	std::cout << "Usage: accuracy [--repetitions=R] [--budget=B] [--conditions=C1,C2,...] [orders...]\n"
+	          << "  Orthonormalises the columns of ill-conditioned matrices with every available solver and prints\n"
+	          << "  the loss of orthogonality ||Q^T Q - I||_F and the best of R runtimes. Then, for each matrix,\n"
+	          << "  names the fastest solver whose loss is within B. Matrices: random orthogonal x graded singular\n"
+	          << "  values x random orthogonal with each condition number C, Hilbert and Kahan.\n"
+	          << "  Defaults: R = 3, B = 1e-10, C = 1e2,1e6,1e10,1e14, orders 16 64 256.\n";
+	return;
+}
+
+
+
+
+
+Settings parse_settings(int const argc, char const *const *const argv)
+{
+	Settings settings;
+	for (int arg_i = 1; arg_i < argc; ++arg_i)
+	{
+		std::string const arg = argv[arg_i];
+		if (arg.rfind("--repetitions=", 0) == 0)
+			settings.repetitions = std::max<size_t>(std::stoull(arg.substr(14)), 1);
+		else if (arg.rfind("--budget=", 0) == 0)
+			settings.budget = std::stod(arg.substr(9));
+		else if (arg.rfind("--conditions=", 0) == 0)
+		{
+			std::stringstream conditions(arg.substr(13));
+			std::string       condition;
+			settings.conditions.clear();
+			while (std::getline(conditions, condition, ','))
+				settings.conditions.push_back(std::stod(condition));
+		}
+		else if ((arg == "--help") || (arg == "-h"))
+		{
+			print_usage();
+			std::exit(0);
+		}
+		else
+			settings.orders.push_back(std::stoull(arg));
+	}
+	if (settings.orders.empty())
+		settings.orders = {16, 64, 256};
+	return settings;
+}
+
+
+
+
+
+// Test matrices
+
+
+
+
+
+/**
+ * @brief Multiplies a matrix by n random Householder reflections from the left or from the right
+ *
+ * The product of the reflections is a random orthogonal matrix, so the singular values are kept.
+ */
+void apply_random_reflections(Matrix &matrix, std::default_random_engine &generator, bool const from_left)
+{
+	size_t const n = matrix.size();
+	std::normal_distribution<double> gaussian(0.0, 1.0);
+	std::vector<double> v(n);
+	for (size_t reflection_i = 0; reflection_i < n; ++reflection_i)
+	{
+		double norm = 0.0;
+		for (auto &elem : v)
+		{
+			elem  = gaussian(generator);
+			norm += elem * elem;
+		}
+		norm = std::sqrt(norm);
+		for (auto &elem : v)
+			elem /= norm;
+		// H = I - 2 v v^T
+		for (size_t line_i = 0; line_i < n; ++line_i)
+		{
+			double dot = 0.0;
+			for (size_t k = 0; k < n; ++k)
+				dot += v[k] * (from_left ? matrix[k][line_i] : matrix[line_i][k]);
+			for (size_t k = 0; k < n; ++k)
+				(from_left ? matrix[k][line_i] : matrix[line_i][k]) -= 2.0 * dot * v[k];
+		}
+	}
+	return;
+}
+
+
+
+
+
+/**
+ * @brief U diag(sigma) V^T with singular values from 1 down to 1/condition, evenly spaced in the
+ * logarithmic scale
+ */
+Matrix graded_matrix(size_t const n, double const condition, std::default_random_engine &generator)
+{
+	Matrix matrix(n, std::vector<double>(n, 0.0));
+	for (size_t i = 0; i < n; ++i)
+		matrix[i][i] = std::pow(condition, -static_cast<double>(i) / std::max<size_t>(n - 1, 1));
+	apply_random_reflections(matrix, generator, true);
+	apply_random_reflections(matrix, generator, false);
+	return matrix;
+}
+
+
+
+
+
+/**
+ * @brief Hilbert matrix, a_ij = 1 / (i + j + 1); numerically singular from order 13 on
+ */
+Matrix hilbert_matrix(size_t const n)
+{
+	Matrix matrix(n, std::vector<double>(n));
+	for (size_t i = 0; i < n; ++i)
+		for (size_t j = 0; j < n; ++j)
+			matrix[i][j] = 1.0 / (i + j + 1);
+	return matrix;
+}
+
+
+
+
+
+/**
+ * @brief Kahan matrix: upper triangular, a_ii = s^i and a_ij = -c s^i for j > i, where s = sin(theta)
+ * and c = cos(theta)
+ */
+Matrix kahan_matrix(size_t const n, double const theta)
+{
+	double const s = std::sin(theta);
+	double const c = std::cos(theta);
+	Matrix matrix(n, std::vector<double>(n, 0.0));
+	double scale = 1.0;
+	for (size_t i = 0; i < n; ++i, scale *= s)
+	{
+		matrix[i][i] = scale;
+		for (size_t j = i + 1; j < n; ++j)
+			matrix[i][j] = -c * scale;
+	}
+	return matrix;
+}
+
+
+
+
+
+std::vector<TestMatrix> generate_test_matrices(Settings const &settings)
+{
+	double const kahan_theta = 1.2;
+	std::default_random_engine generator(0);
+	std::vector<TestMatrix> tests;
+	for (size_t const n : settings.orders)
+	{
+		for (double const condition : settings.conditions)
+		{
+			std::stringstream parameter;
+			parameter << std::setprecision(3) << condition;
+			tests.push_back(TestMatrix{"graded", parameter.str(), graded_matrix(n, condition, generator)});
+		}
+		tests.push_back(TestMatrix{"hilbert", "-", hilbert_matrix(n)});
+		tests.push_back(TestMatrix{"kahan", std::to_string(kahan_theta).substr(0, 3), kahan_matrix(n, kahan_theta)});
+	}
+	return tests;
+}
+
+
+
+
+
+// Solvers
+
+
+
+
+
+std::vector<Solver> available_solvers(void)
+{
+	static char const *const isa_names[] = {"generic", "avx2", "avx512"};
+	std::vector<Solver> solvers;
+
+	// 1. GPU: every work group size, then the hybrid mode. Each solver occupies a queue, so only
+	//    one exists at a time.
+	for (uint32_t const workgroup_size : {32U, 64U, 128U, 256U})
+		solvers.push_back(Solver{"gpu mgs (wg " + std::to_string(workgroup_size) + ")", [workgroup_size](void)
+		{
+			auto solver = std::make_shared<GPUGramSchmidt>(false, false, GPUGramSchmidt::Backend::gpu);
+			solver->set_variant(GPUGramSchmidt::Variant{.workgroup_size = workgroup_size});
+			return std::function<void(Matrix &)>([solver](Matrix &matrix) { solver->run(matrix, true); });
+		}});
+	solvers.push_back(Solver{"hybrid", [](void)
+	{
+		auto solver = std::make_shared<GPUGramSchmidt>(false, false, GPUGramSchmidt::Backend::hybrid);
+		if (solver->get_backend() == GPUGramSchmidt::Backend::cpu)
+			throw std::runtime_error("No GPU for the hybrid mode.");
+		return std::function<void(Matrix &)>([solver](Matrix &matrix) { solver->run(matrix, true); });
+	}});
+
+	// 2. CPU: both algorithms with every instruction set this CPU supports
+	for (uint8_t isa_i = 0; isa_i <= static_cast<uint8_t>(vgs::best_host_isa()); ++isa_i)
+		for (CPUGramSchmidt::Algorithm const algorithm : {CPUGramSchmidt::Algorithm::mgs, CPUGramSchmidt::Algorithm::cgs2})
+		{
+			vgs::HostISA const isa = static_cast<vgs::HostISA>(isa_i);
+			std::string const  name = std::string("cpu ") + ((algorithm == CPUGramSchmidt::Algorithm::mgs) ? "mgs" : "cgs2") + " (" + isa_names[isa_i] + ")";
+			solvers.push_back(Solver{name, [isa, algorithm](void)
+			{
+				auto solver = std::make_shared<CPUGramSchmidt>(0, algorithm);
+				return std::function<void(Matrix &)>([solver, isa](Matrix &matrix) { vgs::set_host_isa(isa); solver->run(matrix, true); });
+			}});
+		}
+
+	// 3. LAPACK, if compiled in
+#ifdef VGS_WITH_LAPACK
+	solvers.push_back(Solver{"lapack", [](void)
+	{
+		auto solver = std::make_shared<LAPACKGramSchmidt>();
+		return std::function<void(Matrix &)>([solver](Matrix &matrix) { solver->run(matrix, true); });
+	}});
+#endif
+
+	return solvers;
+}
+
+
+
+
+
+// Benchmark
+
+
+
+
+
+void benchmarking(Settings const &settings)
+{
+	// Set up a path to "shader_folder" that contains Gram-Schmidt SPIR-V compute shader
+	set_up_shader_folder();
+	vgs::HostISA const best_isa = vgs::host_isa();
+
+	std::vector<TestMatrix> const tests = generate_test_matrices(settings);
+	std::vector<Result>           results;
+
+	// 1. Run every solver on every matrix. Times are in seconds; GFLOP/s is computed from the 2n^3
+	//    flops of the process.
+	std::cout << "family\tparameter\tn\tsolver\tloss\ttime\tGFLOP/s\n";
+	for (Solver const &solver : available_solvers())
+	{
+		std::function<void(Matrix &)> run;
+		try
+		{
+			run = solver.create();
+		}
+		catch (std::exception const &error)
+		{
+			std::cout << "# " << solver.name << " skipped: " << error.what() << "\n";
+			continue;
+		}
+		for (size_t test_i = 0; test_i < tests.size(); ++test_i)
+		{
+			TestMatrix const &test = tests[test_i];
+			double const      n    = test.matrix.size();
+			Result            result{test_i, solver.name, 0.0, std::numeric_limits<double>::infinity()};
+			for (size_t repeat_i = 0; repeat_i < settings.repetitions; ++repeat_i)
+			{
+				Matrix     q(test.matrix);
+				auto const start_time = std::chrono::steady_clock::now();
+				run(q);
+				result.time = std::min(result.time, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+				result.loss = orthogonality_loss(q);
+			}
+			results.push_back(result);
+			std::cout << test.family << '\t' << test.parameter << '\t' << test.matrix.size() << '\t' << solver.name << '\t'
+			          << std::setprecision(3) << result.loss << '\t' << result.time << '\t' << (2.0 * n * n * n / result.time * 1.0e-9) << std::endl;
+		}
+	}
+	vgs::set_host_isa(best_isa);
+
+	// 2. Pick the fastest solver within the budget for each matrix; NaN losses never qualify
+	std::cout << "\n# fastest solver with loss <= " << settings.budget << "\n"
+	          << "family\tparameter\tn\tsolver\tloss\ttime\n";
+	for (size_t test_i = 0; test_i < tests.size(); ++test_i)
+	{
+		Result const *best = nullptr;
+		for (Result const &result : results)
+			if ((result.test_i == test_i) && (result.loss <= settings.budget) && ((best == nullptr) || (result.time < best->time)))
+				best = &result;
+		TestMatrix const &test = tests[test_i];
+		std::cout << test.family << '\t' << test.parameter << '\t' << test.matrix.size() << '\t';
+		if (best == nullptr)
+			std::cout << "none\t-\t-\n";
+		else
+			std::cout << best->solver << '\t' << best->loss << '\t' << best->time << '\n';
+	}
+	return;
+}
+
+
+
+
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		benchmarking(parse_settings(argc, argv));
+	}
+	catch (std::exception &error)
+	{
+		std::cout << "ERROR! " << error.what() << "\n\n";
+		return 1;
+	}
+
+	return 0;
+}
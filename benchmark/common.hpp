@@ -0,0 +1,219 @@
+/**
+ * @file common.hpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#ifndef __VGS_BENCHMARK_COMMON_HPP__
+#define __VGS_BENCHMARK_COMMON_HPP__
+
+
+
+
+
+#include "../vulkan-gram-schmidt/vulkan-gram-schmidt.hpp"
+#include "../vulkan-gram-schmidt/gram-schmidt-engine.hpp"
+#include <random>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <cmath>
+#include <cstdlib>
+
+
+
+
+
+// Helpers shared by the benchmarks; each benchmark is a single translation unit, so they are
+// defined right here
+
+
+
+
+
+/**
+ * @brief Points GPUGramSchmidt::shader_folder to the folder with the SPIR-V shaders
+ *
+ * Taken from the environment variable @c VGS_SHADER_FOLDER, `../vulkan-gram-schmidt` by default.
+ */
+inline void set_up_shader_folder(void)
+{
+	char const *const shader_folder = std::getenv("VGS_SHADER_FOLDER");
+	GPUGramSchmidt::shader_folder = (shader_folder != nullptr) ? (shader_folder) : ("../vulkan-gram-schmidt");
+	return;
+}
+
+
+
+
+
+/**
+ * @brief Reads `--backend=automatic|gpu|cpu|hybrid`
+ *
+ * @param arg Command line argument.
+ * @param backend Set to the backend if @c arg is the option.
+ *
+ * @return Whether @c arg is the option.
+ *
+ * @throw std::runtime_error If the backend is unknown.
+ */
+inline bool parse_backend(std::string const &arg, GPUGramSchmidt::Backend &backend)
+{
+	if (arg.rfind("--backend=", 0) != 0)
+		return false;
+	std::string const name = arg.substr(10);
+	if (name == "automatic")
+		backend = GPUGramSchmidt::Backend::automatic;
+	else if (name == "gpu")
+		backend = GPUGramSchmidt::Backend::gpu;
+	else if (name == "cpu")
+		backend = GPUGramSchmidt::Backend::cpu;
+	else if (name == "hybrid")
+		backend = GPUGramSchmidt::Backend::hybrid;
+	else
+		throw std::runtime_error("Unknown backend '" + name + "'.");
+	return true;
+}
+
+
+
+
+
+inline char const *backend_name(GPUGramSchmidt::Backend const backend)
+{
+	switch (backend)
+	{
+		case GPUGramSchmidt::Backend::gpu:    return "gpu";
+		case GPUGramSchmidt::Backend::cpu:    return "cpu";
+		case GPUGramSchmidt::Backend::hybrid: return "hybrid";
+		default:                              return "automatic";
+	}
+}
+
+
+
+
+
+/**
+ * @brief Fills a matrix with pseudorandom coordinates from [0.001, 20)
+ */
+inline void fill_random(GPUGramSchmidt::Matrix &matrix, std::default_random_engine &generator)
+{
+	std::uniform_real_distribution<double> pseudorandom(0.001, 20.0);
+	for (auto &row : matrix)
+		for (auto &elem : row)
+			elem = pseudorandom(generator);
+	return;
+}
+
+
+
+
+
+/**
+ * @brief Square matrix with pseudorandom coordinates from [0.001, 20)
+ *
+ * The benchmarks that call a solver repeatedly pass it the same matrices again without restoring
+ * them. Orthonormalising an orthonormal matrix takes exactly as many operations as the original
+ * one, and copying would distort the timings of the small orders.
+ */
+inline GPUGramSchmidt::Matrix random_matrix(size_t const n, std::default_random_engine &generator)
+{
+	GPUGramSchmidt::Matrix matrix(n, std::vector<double>(n));
+	fill_random(matrix, generator);
+	return matrix;
+}
+
+
+
+
+
+/**
+ * @brief Loss of orthogonality \f$\|Q^T Q - I\|_F\f$ for the vectors in the columns of @c q
+ */
+inline double orthogonality_loss(GPUGramSchmidt::Matrix const &q)
+{
+	size_t const n    = q.size();
+	double       loss = 0.0;
+	for (size_t i = 0; i < n; ++i)
+		for (size_t j = i; j < n; ++j)
+		{
+			double dot = 0.0;
+			for (size_t k = 0; k < n; ++k)
+				dot += q[k][i] * q[k][j];
+			double const error = dot - ((i == j) ? (1.0) : (0.0));
+			loss += ((i == j) ? (1.0) : (2.0)) * error * error;
+		}
+	return std::sqrt(loss);
+}
+
+
+
+
+
+// Engines
+
+
+
+
+
+/**
+ * @brief Name of an engine kind for reports
+ */
+inline char const *kind_name(GramSchmidtEngine::Kind const kind)
+{
+	switch (kind)
+	{
+		case GramSchmidtEngine::Kind::automatic: return "automatic";
+		case GramSchmidtEngine::Kind::vulkan:    return "vulkan";
+		case GramSchmidtEngine::Kind::hybrid:    return "hybrid";
+		case GramSchmidtEngine::Kind::cpu:       return "cpu";
+		case GramSchmidtEngine::Kind::lapack:    return "lapack";
+	}
+	return "unknown";
+}
+
+
+
+
+
+/**
+ * @brief Engine shared by the consecutive cases of one kind
+ *
+ * Only one engine is kept alive at a time: a GPU may have a single compute queue, which
+ * GPUGramSchmidt occupies exclusively.
+ *
+ * @return The engine or @c nullptr if it is not available (the reason is put into @c error).
+ */
+inline GramSchmidtEngine *shared_engine(GramSchmidtEngine::Kind const kind, std::string &error)
+{
+	static GramSchmidtEngine::Kind                        engine_kind = GramSchmidtEngine::Kind::automatic;
+	static std::unique_ptr<GramSchmidtEngine>             engine;
+	static std::map<GramSchmidtEngine::Kind, std::string> errors;
+	if (errors.count(kind) > 0)
+	{
+		error = errors[kind];
+		return nullptr;
+	}
+	if ((engine == nullptr) || (engine_kind != kind))
+	{
+		engine.reset();
+		try
+		{
+			engine      = GramSchmidtEngine::create(kind);
+			engine_kind = kind;
+		}
+		catch (std::exception const &exception)
+		{
+			error = errors[kind] = exception.what();
+			return nullptr;
+		}
+	}
+	return engine.get();
+}
+
+
+
+
+
+#endif // __VGS_BENCHMARK_COMMON_HPP__
@@ -0,0 +1,299 @@
+/**
+ * @file compare.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "common.hpp"
+#ifdef VGS_WITH_EIGEN
+	#include <Eigen/Dense>
+#endif
+#include <exception>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cmath>
+#include <cstdlib>
+
+
+
+
+
+using Matrix = GPUGramSchmidt::Matrix;
+using Clock  = std::chrono::steady_clock;
+
+
+
+/**
+ * @brief Benchmark settings, see print_usage
+ */
+struct Settings
+{
+	size_t              repetitions = 3;
+	std::vector<size_t> orders;
+};
+
+
+
+/**
+ * @brief Solver under comparison
+ *
+ * @c create sets the solver up and returns a function that orthonormalises the columns of a
+ * matrix in place and returns the time it took, seconds. Conversions into the native layout of
+ * a third-party library are not timed.
+ */
+struct Solver
+{
+	std::string                                          name;
+	std::function<std::function<double(Matrix &)>(void)> create;
+};
+
+
+
+
+
+void print_usage(void)
+{
+	std::cout << "Usage: compare [--repetitions=R] [orders...]\n"
+	          << "  Orthonormalises the columns of the same random matrices with GPUGramSchmidt on GPU, the CPU\n"
+	          << "  backend of the library, a plain single-threaded modified Gram-Schmidt, Eigen's HouseholderQR\n"
+	          << "  (if compiled with -DVGS_WITH_EIGEN) and LAPACK dgeqrf + dorgqr (if compiled with\n"
+	          << "  -DVGS_WITH_LAPACK). Prints the best of R runtimes, the loss of orthogonality ||Q^T Q - I||_F\n"
+	          << "  and the speed-up over the plain MGS for every order.\n"
+	          << "  Defaults: R = 3, orders 16 32 64 128 256 512 1024.\n";
+	return;
+}
+
+
+
+
+
+Settings parse_settings(int const argc, char const *const *const argv)
+{
+	Settings settings;
+	for (int arg_i = 1; arg_i < argc; ++arg_i)
+	{
+		std::string const arg = argv[arg_i];
+		if (arg.rfind("--repetitions=", 0) == 0)
+			settings.repetitions = std::max<size_t>(std::stoull(arg.substr(14)), 1);
+		else if ((arg == "--help") || (arg == "-h"))
+		{
+			print_usage();
+			std::exit(0);
+		}
+		else
+			settings.orders.push_back(std::stoull(arg));
+	}
+	if (settings.orders.empty())
+		settings.orders = {16, 32, 64, 128, 256, 512, 1024};
+	return settings;
+}
+
+
+
+
+
+// Solvers
+
+
+
+
+
+double seconds_since(Clock::time_point const start_time)
+{
+	return std::chrono::duration<double>(Clock::now() - start_time).count();
+}
+
+
+
+
+
+/**
+ * @brief Textbook modified Gram-Schmidt on one thread, with the vectors stored one after another
+ */
+void plain_mgs(std::vector<double> &vectors, size_t const n)
+{
+	for (size_t curr_vec_i = 0; curr_vec_i < n; ++curr_vec_i)
+	{
+		double *const curr_vec = vectors.data() + curr_vec_i * n;
+		double        norm     = 0.0;
+		for (size_t dim_i = 0; dim_i < n; ++dim_i)
+			norm += curr_vec[dim_i] * curr_vec[dim_i];
+		norm = std::sqrt(norm);
+		for (size_t dim_i = 0; dim_i < n; ++dim_i)
+			curr_vec[dim_i] /= norm;
+		for (size_t next_vec_i = curr_vec_i + 1; next_vec_i < n; ++next_vec_i)
+		{
+			double *const next_vec    = vectors.data() + next_vec_i * n;
+			double        dot_product = 0.0;
+			for (size_t dim_i = 0; dim_i < n; ++dim_i)
+				dot_product += curr_vec[dim_i] * next_vec[dim_i];
+			for (size_t dim_i = 0; dim_i < n; ++dim_i)
+				next_vec[dim_i] -= dot_product * curr_vec[dim_i];
+		}
+	}
+	return;
+}
+
+
+
+
+
+std::vector<Solver> available_solvers(void)
+{
+	std::vector<Solver> solvers;
+
+	// 1. The library: the GPU path and its CPU backend, both with the vectors in columns
+	solvers.push_back(Solver{"gpu", [](void)
+	{
+		auto const vgs = std::make_shared<GPUGramSchmidt>(false, false, GPUGramSchmidt::Backend::gpu);
+		return std::function<double(Matrix &)>([vgs](Matrix &matrix)
+		{
+			auto const start_time = Clock::now();
+			vgs->run(matrix, true);
+			return seconds_since(start_time);
+		});
+	}});
+	solvers.push_back(Solver{"cpu", [](void)
+	{
+		auto const cpu = std::make_shared<CPUGramSchmidt>();
+		return std::function<double(Matrix &)>([cpu](Matrix &matrix)
+		{
+			auto const start_time = Clock::now();
+			cpu->run(matrix, true);
+			return seconds_since(start_time);
+		});
+	}});
+
+	// 2. The obvious alternatives
+	solvers.push_back(Solver{"plain mgs", [](void)
+	{
+		return std::function<double(Matrix &)>([](Matrix &matrix)
+		{
+			size_t const        n = matrix.size();
+			std::vector<double> vectors(n * n);
+			for (size_t i = 0; i < n; ++i)
+				for (size_t j = 0; j < n; ++j)
+					vectors[j * n + i] = matrix[i][j];
+			auto const start_time = Clock::now();
+			plain_mgs(vectors, n);
+			double const time = seconds_since(start_time);
+			for (size_t i = 0; i < n; ++i)
+				for (size_t j = 0; j < n; ++j)
+					matrix[i][j] = vectors[j * n + i];
+			return time;
+		});
+	}});
+#ifdef VGS_WITH_EIGEN
+	solvers.push_back(Solver{"eigen", [](void)
+	{
+		return std::function<double(Matrix &)>([](Matrix &matrix)
+		{
+			size_t const    n = matrix.size();
+			Eigen::MatrixXd a(n, n);
+			for (size_t i = 0; i < n; ++i)
+				for (size_t j = 0; j < n; ++j)
+					a(i, j) = matrix[i][j];
+			// Q is formed explicitly, as the other solvers return it
+			auto const start_time = Clock::now();
+			Eigen::HouseholderQR<Eigen::MatrixXd> const qr(a);
+			Eigen::MatrixXd const q = qr.householderQ();
+			double const time = seconds_since(start_time);
+			for (size_t i = 0; i < n; ++i)
+				for (size_t j = 0; j < n; ++j)
+					matrix[i][j] = q(i, j);
+			return time;
+		});
+	}});
+#endif // VGS_WITH_EIGEN
+#ifdef VGS_WITH_LAPACK
+	solvers.push_back(Solver{"lapack", [](void)
+	{
+		auto const lapack = std::make_shared<LAPACKGramSchmidt>();
+		return std::function<double(Matrix &)>([lapack](Matrix &matrix)
+		{
+			auto const start_time = Clock::now();
+			lapack->run(matrix, true);
+			return seconds_since(start_time);
+		});
+	}});
+#endif // VGS_WITH_LAPACK
+	return solvers;
+}
+
+
+
+
+
+void benchmarking(Settings const &settings)
+{
+	// Set up a path to "shader_folder" that contains Gram-Schmidt SPIR-V compute shader
+	set_up_shader_folder();
+
+	// 1. Set up every solver that is available
+	std::vector<std::string>                     names;
+	std::vector<std::function<double(Matrix &)>> runs;
+	for (Solver const &solver : available_solvers())
+		try
+		{
+			runs.push_back(solver.create());
+			names.push_back(solver.name);
+		}
+		catch (std::exception const &error)
+		{
+			std::cout << "# " << solver.name << " skipped: " << error.what() << "\n";
+		}
+
+	// 2. The same matrix goes through every solver. Times are in seconds; GFLOP/s is computed from
+	//    the 2n^3 flops of the process; speed-up is against the plain MGS.
+	std::default_random_engine generator(0);
+	std::cout << "n\tsolver\ttime\tGFLOP/s\tloss\tspeed-up\n";
+	for (size_t const n : settings.orders)
+	{
+		Matrix const matrix = random_matrix(n, generator);
+		std::vector<double> times(runs.size(), std::numeric_limits<double>::infinity());
+		std::vector<double> losses(runs.size(), 0.0);
+		for (size_t solver_i = 0; solver_i < runs.size(); ++solver_i)
+		{
+			Matrix q(matrix);
+			runs[solver_i](q); // warm-up: pipelines, memory, caches
+			for (size_t repeat_i = 0; repeat_i < settings.repetitions; ++repeat_i)
+			{
+				q = matrix;
+				times[solver_i] = std::min(times[solver_i], runs[solver_i](q));
+			}
+			losses[solver_i] = orthogonality_loss(q);
+		}
+		size_t const plain_i = std::find(names.begin(), names.end(), "plain mgs") - names.begin();
+		for (size_t solver_i = 0; solver_i < runs.size(); ++solver_i)
+			std::cout << n << '\t' << names[solver_i] << '\t' << std::setprecision(3) << times[solver_i] << '\t'
+			          << 2.0 * n * n * n / times[solver_i] * 1.0e-9 << '\t' << losses[solver_i] << '\t'
+			          << times[plain_i] / times[solver_i] << std::endl;
+	}
+	return;
+}
+
+
+
+
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		benchmarking(parse_settings(argc, argv));
+	}
+	catch (std::exception &error)
+	{
+		std::cout << "ERROR! " << error.what() << "\n\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,393 @@
+/**
+ * @file cpu-check.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "../vulkan-gram-schmidt/cpu-gram-schmidt.hpp"
+#include "../vulkan-gram-schmidt/host-kernels.hpp"
+#include "../vulkan-gram-schmidt/thread-pool.hpp"
+#include <exception>
+#include <stdexcept>
+#include <random>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+
+
+
+
+using Matrix = CPUGramSchmidt::Matrix;
+
+
+
+/**
+ * @brief Check settings, see print_usage
+ */
+struct Settings
+{
+	double              tolerance = 1.0e-10;
+	std::vector<size_t> orders;
+};
+
+
+
+/**
+ * @brief Number of checks done and failed so far
+ */
+struct Tally
+{
+	size_t check_count   = 0;
+	size_t failure_count = 0;
+};
+
+
+
+
+
+void print_usage(void)
+{
+	std::cout << "Usage: cpu-check [--tolerance=T] [orders...]\n"
+	          << "  Checks the host side of the library without a GPU: the dot/axpy/scale kernels with every\n"
+	          << "  instruction set the CPU supports, the thread pool, and CPUGramSchmidt with MGS and CGS2,\n"
+	          << "  vectors in rows and in columns, against a plain Gram-Schmidt process in long double.\n"
+	          << "  Prints every failed check and a summary; exits with 1 if any check failed.\n"
+	          << "  Defaults: T = 1e-10, orders 1 2 3 5 7 9 13 15 16 17 31 33 63 65 97 129.\n";
+	return;
+}
+
+
+
+
+
+Settings parse_settings(int const argc, char const *const *const argv)
+{
+	Settings settings;
+	for (int arg_i = 1; arg_i < argc; ++arg_i)
+	{
+		std::string const arg = argv[arg_i];
+		if (arg.rfind("--tolerance=", 0) == 0)
+			settings.tolerance = std::stod(arg.substr(12));
+		else if ((arg == "--help") || (arg == "-h"))
+		{
+			print_usage();
+			std::exit(0);
+		}
+		else
+			settings.orders.push_back(std::stoull(arg));
+	}
+	// Odd orders leave tails in the vector kernels and in the blocks of 32 vectors; 2..16 go to
+	// the fixed-size kernels
+	if (settings.orders.empty())
+		settings.orders = {1, 2, 3, 5, 7, 9, 13, 15, 16, 17, 31, 33, 63, 65, 97, 129};
+	return settings;
+}
+
+
+
+
+
+/**
+ * @brief Counts a check and reports it if it failed
+ */
+void expect(Tally &tally, bool const passed, std::string const &description)
+{
+	++tally.check_count;
+	if (passed)
+		return;
+	++tally.failure_count;
+	std::cout << "FAIL\t" << description << std::endl;
+	return;
+}
+
+
+
+
+
+// Reference
+
+
+
+
+
+/**
+ * @brief Well-conditioned random matrix: diagonal dominance keeps it far from singular
+ */
+Matrix random_matrix(size_t const n, std::default_random_engine &generator)
+{
+	std::uniform_real_distribution<double> pseudorandom(-1.0, 1.0);
+	Matrix matrix(n, std::vector<double>(n));
+	for (size_t i = 0; i < n; ++i)
+		for (size_t j = 0; j < n; ++j)
+			matrix[i][j] = pseudorandom(generator) + ((i == j) ? (static_cast<double>(n)) : (0.0));
+	return matrix;
+}
+
+
+
+
+
+/**
+ * @brief Plain modified Gram-Schmidt process in long double, vectors in rows
+ */
+Matrix reference_gram_schmidt(Matrix const &matrix)
+{
+	size_t const n = matrix.size();
+	std::vector<std::vector<long double>> q(n, std::vector<long double>(n));
+	for (size_t i = 0; i < n; ++i)
+	{
+		std::copy(matrix[i].begin(), matrix[i].end(), q[i].begin());
+		for (size_t k = 0; k < i; ++k)
+		{
+			long double dot = 0.0L;
+			for (size_t j = 0; j < n; ++j)
+				dot += q[k][j] * q[i][j];
+			for (size_t j = 0; j < n; ++j)
+				q[i][j] -= dot * q[k][j];
+		}
+		long double norm = 0.0L;
+		for (size_t j = 0; j < n; ++j)
+			norm += q[i][j] * q[i][j];
+		for (size_t j = 0; j < n; ++j)
+			q[i][j] /= std::sqrt(norm);
+	}
+	Matrix answer(n, std::vector<double>(n));
+	for (size_t i = 0; i < n; ++i)
+		std::copy(q[i].begin(), q[i].end(), answer[i].begin());
+	return answer;
+}
+
+
+
+
+
+/**
+ * @brief Largest difference between two matrices of the same order
+ */
+double max_difference(Matrix const &a, Matrix const &b)
+{
+	double difference = 0.0;
+	for (size_t i = 0; i < a.size(); ++i)
+		for (size_t j = 0; j < a.size(); ++j)
+			difference = std::max(difference, std::abs(a[i][j] - b[i][j]));
+	return difference;
+}
+
+
+
+
+
+Matrix transposed(Matrix const &matrix)
+{
+	Matrix answer(matrix.size(), std::vector<double>(matrix.size()));
+	for (size_t i = 0; i < matrix.size(); ++i)
+		for (size_t j = 0; j < matrix.size(); ++j)
+			answer[j][i] = matrix[i][j];
+	return answer;
+}
+
+
+
+
+
+// Checks
+
+
+
+
+
+/**
+ * @brief Kernels against scalar long double loops, for every length up to 40 and misaligned starts
+ */
+void check_kernels(Tally &tally, Settings const &settings, std::string const &isa_name)
+{
+	std::default_random_engine             generator(1);
+	std::uniform_real_distribution<double> pseudorandom(-1.0, 1.0);
+	std::vector<double> x(64), y(64);
+	for (size_t offset = 0; offset < 4; ++offset)
+		for (size_t n = 0; n <= 40; ++n)
+		{
+			for (size_t i = 0; i < x.size(); ++i)
+			{
+				x[i] = pseudorandom(generator);
+				y[i] = pseudorandom(generator);
+			}
+			std::vector<double> const y_before(y);
+			std::string const         where = isa_name + " n=" + std::to_string(n) + " offset=" + std::to_string(offset);
+
+			long double expected_dot = 0.0L;
+			for (size_t i = 0; i < n; ++i)
+				expected_dot += static_cast<long double>(x[offset + i]) * y[offset + i];
+			expect(tally, std::abs(vgs::dot(x.data() + offset, y.data() + offset, n) - expected_dot) <= settings.tolerance, "dot " + where);
+
+			// Coordinates outside [offset, offset + n) must stay untouched
+			vgs::axpy(0.5, x.data() + offset, y.data() + offset, n);
+			bool axpy_passed = true;
+			for (size_t i = 0; i < y.size(); ++i)
+			{
+				double const expected = ((i >= offset) && (i < offset + n)) ? (y_before[i] + 0.5 * x[i]) : (y_before[i]);
+				axpy_passed = axpy_passed && (std::abs(y[i] - expected) <= settings.tolerance);
+			}
+			expect(tally, axpy_passed, "axpy " + where);
+
+			std::vector<double> const x_before(x);
+			vgs::scale(-3.0, x.data() + offset, n);
+			bool scale_passed = true;
+			for (size_t i = 0; i < x.size(); ++i)
+			{
+				double const expected = ((i >= offset) && (i < offset + n)) ? (-3.0 * x_before[i]) : (x_before[i]);
+				scale_passed = scale_passed && (std::abs(x[i] - expected) <= settings.tolerance);
+			}
+			expect(tally, scale_passed, "scale " + where);
+		}
+	return;
+}
+
+
+
+
+
+/**
+ * @brief Every index of a parallel loop is visited exactly once, also in nested loops, and an
+ * exception in a chunk reaches the caller after the other chunks are done
+ */
+void check_thread_pool(Tally &tally)
+{
+	for (uint32_t const thread_count : {1U, 2U, 3U, 0U})
+	{
+		vgs::ThreadPool pool(thread_count);
+		for (size_t const grain : {size_t(1), size_t(3), size_t(7), size_t(1000)})
+		{
+			std::string const   where = "threads=" + std::to_string(pool.size()) + " grain=" + std::to_string(grain);
+			size_t const        outer = 37;
+			size_t const        inner = 29;
+			std::vector<std::atomic<uint32_t>> visits(outer * inner);
+			for (auto &visit : visits)
+				visit.store(0);
+			pool.parallel_for(0, outer, grain, [&](size_t const first_i, size_t const last_i)
+			{
+				for (size_t i = first_i; i < last_i; ++i)
+					pool.parallel_for(0, inner, grain, [&](size_t const first_j, size_t const last_j)
+					{
+						for (size_t j = first_j; j < last_j; ++j)
+							visits[i * inner + j].fetch_add(1);
+					});
+			});
+			expect(tally, std::all_of(visits.begin(), visits.end(), [](std::atomic<uint32_t> const &visit) { return visit.load() == 1; }), "thread pool nested loop " + where);
+
+			std::atomic<uint32_t> worker_visits(0);
+			pool.parallel_for_on_workers(5, 5 + outer, grain, [&](size_t const first_i, size_t const last_i) { worker_visits.fetch_add(last_i - first_i); });
+			expect(tally, worker_visits.load() == outer, "thread pool loop on workers " + where);
+
+			for (bool const on_workers : {false, true})
+			{
+				std::atomic<uint32_t> chunk_visits(0);
+				bool                  thrown = false;
+				auto const failing_body = [&](size_t const first_i, size_t const last_i)
+				{
+					chunk_visits.fetch_add(last_i - first_i);
+					if ((first_i <= outer / 2) && (outer / 2 < last_i))
+						throw std::runtime_error("chunk failed");
+				};
+				try
+				{
+					if (on_workers)
+						pool.parallel_for_on_workers(0, outer, grain, failing_body);
+					else
+						pool.parallel_for(0, outer, grain, failing_body);
+				}
+				catch (std::runtime_error &)
+				{
+					thrown = true;
+				}
+				expect(tally, (thrown) && (chunk_visits.load() == outer), std::string("thread pool exception") + ((on_workers) ? (" on workers ") : (" ")) + where);
+			}
+		}
+	}
+	return;
+}
+
+
+
+
+
+/**
+ * @brief CPUGramSchmidt::run and CPUGramSchmidt::run_batch against the reference
+ */
+void check_solver(Tally &tally, Settings const &settings, std::string const &isa_name)
+{
+	std::default_random_engine generator(0);
+	for (CPUGramSchmidt::Algorithm const algorithm : {CPUGramSchmidt::Algorithm::mgs, CPUGramSchmidt::Algorithm::cgs2})
+		for (uint32_t const thread_count : {1U, 3U, 0U})
+		{
+			CPUGramSchmidt    solver(thread_count, algorithm);
+			std::string const solver_name = std::string((algorithm == CPUGramSchmidt::Algorithm::mgs) ? ("mgs") : ("cgs2")) + " " + isa_name + " threads=" + std::to_string(solver.thread_count());
+			std::vector<Matrix> batch;
+			std::vector<Matrix> batch_expected;
+			for (size_t const n : settings.orders)
+			{
+				Matrix const matrix   = random_matrix(n, generator);
+				Matrix const expected = reference_gram_schmidt(matrix);
+				for (bool const vectors_as_columns : {false, true})
+				{
+					std::string const where = solver_name + " n=" + std::to_string(n) + ((vectors_as_columns) ? (" columns") : (" rows"));
+					Matrix answer = (vectors_as_columns) ? (transposed(matrix)) : (matrix);
+					solver.run(answer, vectors_as_columns);
+					expect(tally, max_difference((vectors_as_columns) ? (transposed(answer)) : (answer), expected) <= settings.tolerance, "run " + where);
+				}
+				batch.push_back(matrix);
+				batch_expected.push_back(expected);
+			}
+			solver.run_batch(batch);
+			for (size_t matrix_i = 0; matrix_i < batch.size(); ++matrix_i)
+				expect(tally, max_difference(batch[matrix_i], batch_expected[matrix_i]) <= settings.tolerance, "run_batch " + solver_name + " n=" + std::to_string(batch[matrix_i].size()));
+		}
+	return;
+}
+
+
+
+
+
+Tally checking(Settings const &settings)
+{
+	static char const *const isa_names[] = {"generic", "avx2", "avx512"};
+	vgs::HostISA const best_isa = vgs::host_isa();
+	Tally tally;
+
+	check_thread_pool(tally);
+	for (uint8_t isa_i = 0; isa_i <= static_cast<uint8_t>(vgs::best_host_isa()); ++isa_i)
+	{
+		vgs::set_host_isa(static_cast<vgs::HostISA>(isa_i));
+		check_kernels(tally, settings, isa_names[isa_i]);
+		check_solver(tally, settings, isa_names[isa_i]);
+	}
+	vgs::set_host_isa(best_isa);
+
+	std::cout << "# " << tally.check_count << " checks, " << tally.failure_count << " failed (instruction sets up to "
+	          << isa_names[static_cast<uint8_t>(vgs::best_host_isa())] << ")" << std::endl;
+	return tally;
+}
+
+
+
+
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		if (checking(parse_settings(argc, argv)).failure_count > 0)
+			return 1;
+	}
+	catch (std::exception &error)
+	{
+		std::cout << "ERROR! " << error.what() << "\n\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,351 @@
+/**
+ * @file latency.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "common.hpp"
+#include <exception>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+
+
+
+
+
+using Matrix  = GPUGramSchmidt::Matrix;
+using Backend = GPUGramSchmidt::Backend;
+using Clock   = std::chrono::steady_clock;
+
+
+
+/**
+ * @brief Benchmark settings, see print_usage
+ */
+struct Settings
+{
+	Backend                                backend      = Backend::automatic;
+	double                                 rate         = 100.0; // requests per second
+	double                                 duration     = 10.0;  // seconds of arrivals
+	std::vector<std::pair<size_t, double>> mix          = {{16, 0.6}, {64, 0.3}, {256, 0.1}}; // order and weight of each size class
+	size_t                                 worker_count = 1;
+	bool                                   poisson      = false;
+};
+
+
+
+/**
+ * @brief One request: a matrix of a size class and the moment it was due
+ */
+struct Request
+{
+	size_t            class_i;
+	Clock::time_point arrival_time;
+};
+
+
+
+/**
+ * @class LatencyHistogram
+ * @brief Histogram of nanosecond latencies with a relative error below 0.1% (HDR-style)
+ *
+ * Values below 2048 ns have a bucket each. Above, every power of two is split into 1024 linear
+ * buckets, so the bucket width is at most 1/1024 of the value. Memory is fixed (a few hundred
+ * kilobytes) whatever the number of values.
+ */
+class LatencyHistogram final
+{
+	static constexpr uint32_t sub_bucket_bits = 10;
+	static constexpr uint32_t sub_bucket_half = 1U << sub_bucket_bits;
+	static constexpr uint32_t max_exponent    = 40; // up to 2^51 ns, about 26 days
+
+	std::vector<uint64_t> counts;
+	uint64_t              total_count;
+	uint64_t              max_value;
+
+	static size_t index_of(uint64_t const value)
+	{
+		if (value < 2 * sub_bucket_half)
+			return value;
+		uint32_t const exponent = std::min<uint32_t>(std::bit_width(value) - sub_bucket_bits - 1, max_exponent);
+		return exponent * sub_bucket_half + std::min<uint64_t>(value >> exponent, 2 * sub_bucket_half - 1);
+	}
+
+	// Largest value that falls into the bucket
+	static uint64_t highest_value_of(size_t const index)
+	{
+		if (index < 2 * sub_bucket_half)
+			return index;
+		uint32_t const exponent = index / sub_bucket_half - 1;
+		uint64_t const mantissa = index - exponent * sub_bucket_half;
+		return ((mantissa + 1) << exponent) - 1;
+	}
+
+public:
+
+	LatencyHistogram(void) :
+		counts((max_exponent + 2) * sub_bucket_half, 0),
+		total_count(0),
+		max_value(0)
+	{}
+
+	void add(uint64_t const value)
+	{
+		++this->counts[index_of(value)];
+		++this->total_count;
+		this->max_value = std::max(this->max_value, value);
+		return;
+	}
+
+	void merge(LatencyHistogram const &other)
+	{
+		for (size_t bucket_i = 0; bucket_i < this->counts.size(); ++bucket_i)
+			this->counts[bucket_i] += other.counts[bucket_i];
+		this->total_count += other.total_count;
+		this->max_value    = std::max(this->max_value, other.max_value);
+		return;
+	}
+
+	uint64_t count(void) const
+	{
+		return this->total_count;
+	}
+
+	/**
+	 * @brief Value at or below which the given share of the values lies (0 if empty)
+	 */
+	uint64_t percentile(double const share) const
+	{
+		uint64_t const rank       = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(share * this->total_count)));
+		uint64_t       cumulative = 0;
+		for (size_t bucket_i = 0; bucket_i < this->counts.size(); ++bucket_i)
+		{
+			cumulative += this->counts[bucket_i];
+			if (cumulative >= rank)
+				return std::min(highest_value_of(bucket_i), this->max_value);
+		}
+		return this->max_value;
+	}
+
+	uint64_t max(void) const
+	{
+		return this->max_value;
+	}
+};
+
+
+
+
+
+void print_usage(void)
+{
+	std::cout << "Usage: latency [--backend=automatic|gpu|cpu|hybrid] [--rate=R] [--duration=D] [--mix=N1:W1,N2:W2,...] [--workers=K] [--poisson]\n"
+	          << "  Issues R requests per second for D seconds, whether or not the previous ones are done (open\n"
+	          << "  loop): evenly spaced, or with exponential gaps with --poisson. Each request is a matrix of order\n"
+	          << "  Ni with probability proportional to Wi. K workers, each with a solver of its own, serve the\n"
+	          << "  requests in the order of arrival. The latency of a request counts from the moment it was due,\n"
+	          << "  so the time spent in the queue is included. Prints p50, p99, p999 and the throughput per order.\n"
+	          << "  Defaults: R = 100, D = 10, mix 16:0.6,64:0.3,256:0.1, K = 1.\n";
+	return;
+}
+
+
+
+
+
+Settings parse_settings(int const argc, char const *const *const argv)
+{
+	Settings settings;
+	for (int arg_i = 1; arg_i < argc; ++arg_i)
+	{
+		std::string const arg = argv[arg_i];
+		if (parse_backend(arg, settings.backend))
+			continue;
+		if (arg.rfind("--rate=", 0) == 0)
+			settings.rate = std::stod(arg.substr(7));
+		else if (arg.rfind("--duration=", 0) == 0)
+			settings.duration = std::stod(arg.substr(11));
+		else if (arg.rfind("--mix=", 0) == 0)
+		{
+			std::stringstream classes(arg.substr(6));
+			std::string       size_class;
+			settings.mix.clear();
+			while (std::getline(classes, size_class, ','))
+			{
+				size_t const colon_i = size_class.find(':');
+				settings.mix.emplace_back(std::stoull(size_class.substr(0, colon_i)), (colon_i == std::string::npos) ? (1.0) : (std::stod(size_class.substr(colon_i + 1))));
+			}
+		}
+		else if (arg.rfind("--workers=", 0) == 0)
+			settings.worker_count = std::max<size_t>(std::stoull(arg.substr(10)), 1);
+		else if (arg == "--poisson")
+			settings.poisson = true;
+		else if ((arg == "--help") || (arg == "-h"))
+		{
+			print_usage();
+			std::exit(0);
+		}
+		else
+			throw std::runtime_error("Unknown argument '" + arg + "'.");
+	}
+	if ((settings.rate <= 0.0) || (settings.mix.empty()))
+		throw std::runtime_error("The rate must be positive and the mix must not be empty.");
+	return settings;
+}
+
+
+
+
+
+// Load
+
+
+
+
+
+void print_row(std::string const &size_class, LatencyHistogram const &histogram, double const wall_time)
+{
+	std::cout << size_class << '\t' << histogram.count() << '\t' << std::setprecision(4) << histogram.count() / wall_time;
+	if (histogram.count() == 0)
+		std::cout << "\t-\t-\t-\t-\n";
+	else
+		std::cout << '\t' << histogram.percentile(0.5) * 1.0e-9 << '\t' << histogram.percentile(0.99) * 1.0e-9 << '\t'
+		          << histogram.percentile(0.999) * 1.0e-9 << '\t' << histogram.max() * 1.0e-9 << '\n';
+	return;
+}
+
+
+
+
+
+void benchmarking(Settings const &settings)
+{
+	// Set up a path to "shader_folder" that contains Gram-Schmidt SPIR-V compute shader
+	set_up_shader_folder();
+	size_t const class_count = settings.mix.size();
+
+	// 1. Workers: a solver each, ready for all the orders of the mix
+	std::vector<size_t> orders;
+	for (auto const &size_class : settings.mix)
+		orders.push_back(size_class.first);
+	std::vector<std::unique_ptr<GPUGramSchmidt>> solvers;
+	for (size_t worker_i = 0; worker_i < settings.worker_count; ++worker_i)
+	{
+		solvers.emplace_back(new GPUGramSchmidt(false, false, settings.backend));
+		solvers.back()->warm_up(orders);
+	}
+
+	// 2. Serve the requests in the order of arrival. Latencies are recorded per worker and size
+	//    class, and merged at the end.
+	std::mutex                                 queue_lock;
+	std::condition_variable                    queue_filled;
+	std::deque<Request>                        queue;
+	bool                                       arrivals_over = false;
+	std::vector<std::vector<LatencyHistogram>> histograms(settings.worker_count, std::vector<LatencyHistogram>(class_count));
+	std::vector<std::thread>                   workers;
+	for (size_t worker_i = 0; worker_i < settings.worker_count; ++worker_i)
+		workers.emplace_back([&, worker_i](void)
+		{
+			std::default_random_engine generator(worker_i);
+			std::vector<Matrix>        matrices;
+			for (auto const &size_class : settings.mix)
+				matrices.push_back(random_matrix(size_class.first, generator));
+			while (true)
+			{
+				Request request;
+				{
+					std::unique_lock<std::mutex> guard(queue_lock);
+					queue_filled.wait(guard, [&](void) { return (!queue.empty()) || (arrivals_over); });
+					if (queue.empty())
+						return;
+					request = queue.front();
+					queue.pop_front();
+				}
+				solvers[worker_i]->run(matrices[request.class_i]);
+				histograms[worker_i][request.class_i].add(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - request.arrival_time).count());
+			}
+		});
+
+	// 3. Generate the arrivals on schedule. A late generator does not shift the schedule, so a
+	//    slow system cannot slow down its own load.
+	std::vector<double> weights;
+	for (auto const &size_class : settings.mix)
+		weights.push_back(size_class.second);
+	std::default_random_engine            generator(0);
+	std::exponential_distribution<double> gap(settings.rate);
+	std::discrete_distribution<size_t>    pick_class(weights.begin(), weights.end());
+	auto const                            start_time    = Clock::now();
+	double                                arrival_time  = 0.0;
+	size_t                                request_count = 0;
+	while (arrival_time < settings.duration)
+	{
+		Clock::time_point const due_time = start_time + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(arrival_time));
+		std::this_thread::sleep_until(due_time);
+		{
+			std::lock_guard<std::mutex> guard(queue_lock);
+			queue.push_back(Request{pick_class(generator), due_time});
+		}
+		queue_filled.notify_one();
+		++request_count;
+		arrival_time += (settings.poisson) ? (gap(generator)) : (1.0 / settings.rate);
+	}
+	{
+		std::lock_guard<std::mutex> guard(queue_lock);
+		arrivals_over = true;
+	}
+	queue_filled.notify_all();
+	for (auto &worker : workers)
+		worker.join();
+	double const wall_time = std::chrono::duration<double>(Clock::now() - start_time).count();
+
+	// 4. Report. Latencies are in seconds; throughput is in completed requests per second over the
+	//    whole run, including the draining of the queue.
+	std::cout << "# offered: " << std::setprecision(4) << request_count / settings.duration << " requests/s, achieved: "
+	          << request_count / wall_time << " requests/s over " << wall_time << " s\n";
+	if (wall_time > 1.05 * settings.duration)
+		std::cout << "# the solvers could not keep up: the queue was still being drained after the arrivals had stopped\n";
+	std::cout << "order\trequests\tthroughput\tp50\tp99\tp999\tmax\n";
+	LatencyHistogram overall;
+	for (size_t class_i = 0; class_i < class_count; ++class_i)
+	{
+		LatencyHistogram size_class;
+		for (auto const &worker_histograms : histograms)
+			size_class.merge(worker_histograms[class_i]);
+		overall.merge(size_class);
+		print_row(std::to_string(settings.mix[class_i].first), size_class, wall_time);
+	}
+	print_row("all", overall, wall_time);
+	return;
+}
+
+
+
+
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		benchmarking(parse_settings(argc, argv));
+	}
+	catch (std::exception &error)
+	{
+		std::cout << "ERROR! " << error.what() << "\n\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -2,71 +2,170 @@
  * @file main.cpp
  * @author JointPoints, 2021, github.com/jointpoints
  */
-#include "../vulkan-gram-schmidt/vulkan-gram-schmidt.hpp"
+#include "common.hpp"
 #include <exception>
 #include <chrono>
 #include <random>
 #include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdlib>
 
 
 
 
 
-double average_time_for_one_random_matrix(std::default_random_engine &generator, std::uniform_real_distribution<double> &pseudorandom, GPUGramSchmidt &vgs, uint8_t const n, uint8_t const repetitions = 10)
+/**
+ * @brief Benchmark settings, see print_usage
+ */
+struct Settings
+{
+	GPUGramSchmidt::Backend backend      = GPUGramSchmidt::Backend::automatic;
+	size_t                  matrix_count = 10;
+	size_t                  repetitions  = 3;
+	bool                    gpu_timing   = false;
+	std::vector<size_t>     orders;
+};
+
+
+
+/**
+ * @brief Measurements for one matrix order
+ */
+struct OrderResult
+{
+	GPUGramSchmidt::RunStats mean;                  // average over all runs
+	double                   first_allocation_time; // allocation is only paid by the first run of a new order
+	std::string              backends;              // devices that did the runs
+};
+
+
+
+
+
+void print_usage(void)
+{
+	std::cout << "Usage: benchmark [--backend=automatic|gpu|cpu|hybrid] [--matrices=M] [--repetitions=R] [--gpu-timing] [orders...]\n"
+	          << "  Runs the solver on M random matrices of each order, R times each, and prints the average\n"
+	          << "  duration of each phase of GPUGramSchmidt::run. Default orders: 2 5 10 50 100 500 1000 2000.\n"
+	          << "  --gpu-timing also measures the execution on GPU with GPU timestamps.\n";
+	return;
+}
+
+
+
+
+
+Settings parse_settings(int const argc, char const *const *const argv)
 {
+	Settings settings;
+	for (int arg_i = 1; arg_i < argc; ++arg_i)
+	{
+		std::string const arg = argv[arg_i];
+		if (parse_backend(arg, settings.backend))
+			continue;
+		if (arg.rfind("--matrices=", 0) == 0)
+			settings.matrix_count = std::max<size_t>(std::stoull(arg.substr(11)), 1);
+		else if (arg.rfind("--repetitions=", 0) == 0)
+			settings.repetitions = std::max<size_t>(std::stoull(arg.substr(14)), 1);
+		else if (arg == "--gpu-timing")
+			settings.gpu_timing = true;
+		else if ((arg == "--help") || (arg == "-h"))
+		{
+			print_usage();
+			std::exit(0);
+		}
+		else
+			settings.orders.push_back(std::stoull(arg));
+	}
+	if (settings.orders.empty())
+		settings.orders = {2, 5, 10, 50, 100, 500, 1000, 2000};
+	return settings;
+}
+
+
+
+
+
+OrderResult average_stats_for_random_matrices(std::default_random_engine &generator, GPUGramSchmidt &vgs, size_t const n, Settings const &settings)
+{
+	OrderResult result{GPUGramSchmidt::RunStats(), 0.0, ""};
+	size_t      run_count = 0;
 	GPUGramSchmidt::Matrix matrix(n, std::vector<double>(n, 0.0));
-	auto start_time = std::chrono::high_resolution_clock::now();
-	auto runtime = std::chrono::high_resolution_clock::now() - start_time;
-	double total_runtime = 0.0;
-
-	for (auto &row : matrix)
-		for (uint32_t i = 0; i < n; ++i)
-			row[i] = pseudorandom(generator);
-	
-	start_time = std::chrono::high_resolution_clock::now();
-	for (uint8_t repeat_i = 0; repeat_i < repetitions; ++repeat_i)
+
+	for (size_t matrix_i = 0; matrix_i < settings.matrix_count; ++matrix_i)
 	{
-		GPUGramSchmidt::Matrix matrix_copy(matrix);
-		start_time = std::chrono::high_resolution_clock::now();
-		vgs.run(matrix_copy);
-		runtime = std::chrono::high_resolution_clock::now() - start_time;
-		total_runtime += std::chrono::duration_cast<std::chrono::microseconds>(runtime).count() * 0.000001;
+		fill_random(matrix, generator);
+		for (size_t repeat_i = 0; repeat_i < settings.repetitions; ++repeat_i)
+		{
+			GPUGramSchmidt::Matrix   matrix_copy(matrix);
+			GPUGramSchmidt::RunStats stats;
+			vgs.run(matrix_copy, false, &stats);
+			if (run_count == 0)
+				result.first_allocation_time = stats.allocation_time;
+			else
+				result.mean.allocation_time += stats.allocation_time;
+			result.mean.upload_time      += stats.upload_time;
+			result.mean.compute_time     += stats.compute_time;
+			result.mean.gpu_compute_time += stats.gpu_compute_time;
+			result.mean.download_time    += stats.download_time;
+			if (result.backends.find(backend_name(stats.backend)) == std::string::npos)
+				result.backends += (result.backends.empty() ? "" : "+") + std::string(backend_name(stats.backend));
+			++run_count;
+		}
 	}
 
-	return total_runtime / repetitions;
+	// The first allocation is reported on its own, the rest are averaged
+	result.mean.allocation_time  /= std::max<size_t>(run_count - 1, 1);
+	result.mean.upload_time      /= run_count;
+	result.mean.compute_time     /= run_count;
+	result.mean.gpu_compute_time /= run_count;
+	result.mean.download_time    /= run_count;
+	return result;
 }
 
 
 
 
 
-void benchmarking(void)
+void benchmarking(Settings const &settings)
 {
 	// Set up a path to "shader_folder" that contains Gram-Schmidt SPIR-V compute shader
-	GPUGramSchmidt::shader_folder = "../vulkan-gram-schmidt";
-	// Create GPU solver
-	GPUGramSchmidt vgs(true);
+	set_up_shader_folder();
+	// Create the solver and push a tiny workload through it, so that the deferred work of the
+	// driver is not attributed to the first order
+	GPUGramSchmidt vgs(false, false, settings.backend);
+	vgs.set_gpu_timing(settings.gpu_timing);
+	GPUGramSchmidt::Matrix dummy{{1.0, 0.0}, {0.0, 1.0}};
+	vgs.run(dummy);
 	// Create pseudorandom number generator
 	std::default_random_engine generator(0);
-	std::uniform_real_distribution<double> pseudorandom(0.001, 20.0);
-	// Perform tests on random matrices of different orders
-	uint8_t const orders_count = 10;
-	uint16_t const orders[] = {2, 5, 10, 50, 100, 500, 1000, 5000, 10000, 50000};
-	double average_runtimes[orders_count];
-	for (uint8_t order_i = 0; order_i < orders_count; ++order_i)
+
+	// Perform tests on random matrices of different orders. Times are in seconds; GFLOP/s is
+	// computed from the 2n^3 flops of the process and the compute phase only; GB/s is the rate of
+	// the copying of the n^2 doubles to and from the device memory. gpu_compute is the part of
+	// compute spent on GPU according to the GPU timestamps (0 without --gpu-timing).
+	std::cout << "# backend: " << backend_name(vgs.get_backend()) << ", " << settings.matrix_count << " matrices x " << settings.repetitions << " repetitions per order"
+	          << (vgs.get_gpu_timing() ? ", GPU timing" : "") << "\n";
+	std::cout << "n\tdevice\talloc_first\talloc\tupload\tcompute\tgpu_compute\tdownload\ttotal\tGFLOP/s\tGB/s\n";
+	std::cout << std::setprecision(4);
+	for (size_t const n : settings.orders)
 	{
-		average_runtimes[order_i] = 0.0;
-		for (uint8_t matrix_i = 0; matrix_i < 50; ++matrix_i)
-			average_runtimes[order_i] += average_time_for_one_random_matrix(generator, pseudorandom, vgs, orders[order_i]);
-		average_runtimes[order_i] /= 50;
-		std::cout << orders[order_i] << '\t' << average_runtimes[order_i] << '\n';
+		OrderResult const result     = average_stats_for_random_matrices(generator, vgs, n, settings);
+		double const      total_time = result.mean.allocation_time + result.mean.upload_time + result.mean.compute_time + result.mean.download_time;
+		double const      flops      = 2.0 * n * n * n;
+		double const      bytes      = 2.0 * n * n * sizeof(double);
+		double const      copy_time  = result.mean.upload_time + result.mean.download_time;
+		std::cout << n << '\t' << result.backends << '\t'
+		          << result.first_allocation_time << '\t' << result.mean.allocation_time << '\t'
+		          << result.mean.upload_time << '\t' << result.mean.compute_time << '\t' << result.mean.gpu_compute_time << '\t' << result.mean.download_time << '\t'
+		          << total_time << '\t'
+		          << ((result.mean.compute_time > 0.0) ? (flops / result.mean.compute_time * 1.0e-9) : (0.0)) << '\t'
+		          << ((copy_time > 0.0) ? (bytes / copy_time * 1.0e-9) : (0.0)) << std::endl;
 	}
-	/*for (auto &row : matrix)
-	{
-		for (auto &elem : row)
-			std::cout << elem << '\t';
-		std::cout << '\n';
-	}*/
 	return;
 }
 
@@ -74,16 +173,16 @@ void benchmarking(void)
 
 
 
-int main(void)
+int main(int argc, char **argv)
 {
 	try
 	{
-		benchmarking();
+		benchmarking(parse_settings(argc, argv));
 	}
 	catch (std::exception &error)
 	{
 		std::cout << "ERROR! " << error.what() << "\n\n";
-		system("pause");
+		return 1;
 	}
 
 	return 0;
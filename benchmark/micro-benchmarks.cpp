@@ -0,0 +1,221 @@
+/**
+ * @file micro-benchmarks.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "common.hpp"
+#include "../vulkan-gram-schmidt/gram-schmidt-engine.hpp"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <map>
+#include <memory>
+#include <string>
+#include <exception>
+#include <cstdlib>
+
+
+
+
+
+// Helpers
+
+
+
+
+
+using Kind = GramSchmidtEngine::Kind;
+
+
+
+
+
+/**
+ * @brief Random square matrix; the same seed gives the same matrix
+ */
+static GramSchmidtEngine::Matrix seeded_matrix(size_t const n, uint32_t const seed)
+{
+	std::default_random_engine generator(seed);
+	return random_matrix(n, generator);
+}
+
+
+
+
+
+// Cases
+
+
+
+
+
+/**
+ * @brief Creation and destruction of an engine (args: engine kind)
+ */
+static void solver_construction(benchmark::State &state)
+{
+	Kind const kind = static_cast<Kind>(state.range(0));
+	state.SetLabel(kind_name(kind));
+	for (auto _ : state)
+	{
+		try
+		{
+			auto engine = GramSchmidtEngine::create(kind);
+			benchmark::DoNotOptimize(engine.get());
+		}
+		catch (std::exception const &exception)
+		{
+			state.SkipWithError(exception.what());
+			break;
+		}
+	}
+	return;
+}
+
+
+
+
+
+/**
+ * @brief One matrix per call (args: engine kind, order, vectors as columns)
+ */
+static void run(benchmark::State &state)
+{
+	Kind const   kind               = static_cast<Kind>(state.range(0));
+	size_t const n                  = state.range(1);
+	bool const   vectors_as_columns = state.range(2) != 0;
+	std::string  error;
+	GramSchmidtEngine *const engine = shared_engine(kind, error);
+	if (engine == nullptr)
+	{
+		state.SkipWithError(error.c_str());
+		return;
+	}
+	state.SetLabel(engine->capabilities().name + (vectors_as_columns ? ", columns" : ", rows"));
+
+	// Google Benchmark does not catch exceptions, so an engine that fails must skip the case
+	GramSchmidtEngine::Matrix matrix = seeded_matrix(n, n);
+	try
+	{
+		engine->run(matrix, vectors_as_columns); // warm-up: pipelines, memory
+		for (auto _ : state)
+		{
+			engine->run(matrix, vectors_as_columns);
+			benchmark::ClobberMemory();
+		}
+	}
+	catch (std::exception const &exception)
+	{
+		state.SkipWithError(exception.what());
+		return;
+	}
+	state.SetItemsProcessed(state.iterations());
+	state.counters["FLOP/s"] = benchmark::Counter(2.0 * n * n * n * state.iterations(), benchmark::Counter::kIsRate);
+	return;
+}
+
+
+
+
+
+/**
+ * @brief Many matrices of the same order per call (args: engine kind, order, batch size)
+ */
+static void run_batch(benchmark::State &state)
+{
+	Kind const   kind       = static_cast<Kind>(state.range(0));
+	size_t const n          = state.range(1);
+	size_t const batch_size = state.range(2);
+	std::string  error;
+	GramSchmidtEngine *const engine = shared_engine(kind, error);
+	if (engine == nullptr)
+	{
+		state.SkipWithError(error.c_str());
+		return;
+	}
+	state.SetLabel(engine->capabilities().name);
+
+	std::vector<GramSchmidtEngine::Matrix> matrices;
+	for (size_t matrix_i = 0; matrix_i < batch_size; ++matrix_i)
+		matrices.push_back(seeded_matrix(n, matrix_i));
+	try
+	{
+		engine->run_batch(matrices); // warm-up: pipelines, memory
+		for (auto _ : state)
+		{
+			engine->run_batch(matrices);
+			benchmark::ClobberMemory();
+		}
+	}
+	catch (std::exception const &exception)
+	{
+		state.SkipWithError(exception.what());
+		return;
+	}
+	state.SetItemsProcessed(state.iterations() * batch_size);
+	state.counters["FLOP/s"] = benchmark::Counter(2.0 * n * n * n * batch_size * state.iterations(), benchmark::Counter::kIsRate);
+	return;
+}
+
+
+
+
+
+// Registration
+
+
+
+
+
+static void all_kinds(benchmark::internal::Benchmark *const benchmark)
+{
+	for (Kind const kind : {Kind::automatic, Kind::vulkan, Kind::hybrid, Kind::cpu, Kind::lapack})
+		benchmark->Args({static_cast<int64_t>(kind)});
+	return;
+}
+
+
+
+static void run_arguments(benchmark::internal::Benchmark *const benchmark)
+{
+	benchmark->ArgNames({"engine", "n", "columns"});
+	for (Kind const kind : {Kind::automatic, Kind::vulkan, Kind::hybrid, Kind::cpu, Kind::lapack})
+		for (int64_t const n : {2, 3, 4, 8, 16, 32, 64, 128, 256, 512, 1024})
+			for (int64_t const columns : {0, 1})
+				benchmark->Args({static_cast<int64_t>(kind), n, columns});
+	return;
+}
+
+
+
+static void batch_arguments(benchmark::internal::Benchmark *const benchmark)
+{
+	benchmark->ArgNames({"engine", "n", "batch"});
+	for (Kind const kind : {Kind::automatic, Kind::vulkan, Kind::cpu, Kind::lapack})
+		for (int64_t const n : {3, 4, 6, 16, 64})
+			for (int64_t const batch_size : {1, 16, 256, 4096})
+				if (n * n * batch_size <= 64 * 64 * 256)
+					benchmark->Args({static_cast<int64_t>(kind), n, batch_size});
+	return;
+}
+
+
+
+BENCHMARK(solver_construction)->Apply(all_kinds)->ArgName("engine")->Unit(benchmark::kMillisecond);
+BENCHMARK(run)->Apply(run_arguments)->Unit(benchmark::kMicrosecond);
+BENCHMARK(run_batch)->Apply(batch_arguments)->Unit(benchmark::kMicrosecond);
+
+
+
+
+
+int main(int argc, char **argv)
+{
+	// The shaders are looked up next to the library sources unless told otherwise
+	set_up_shader_folder();
+
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv))
+		return 1;
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
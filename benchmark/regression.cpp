@@ -0,0 +1,402 @@
+/**
+ * @file regression.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "common.hpp"
+#include "../vulkan-gram-schmidt/gram-schmidt-engine.hpp"
+#include <exception>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cstdlib>
+
+
+
+
+
+using Kind = GramSchmidtEngine::Kind;
+
+
+
+/**
+ * @brief Harness settings, see print_usage
+ */
+struct Settings
+{
+	std::string baseline_path;        // compare with this baseline, if not empty
+	std::string save_path;            // save the results as a new baseline, if not empty
+	double      threshold   = 0.10;   // allowed relative slowdown of the median
+	size_t      trial_count = 15;     // measured trials per case
+	double      trial_time  = 2.0e-3; // minimal duration of a trial, seconds
+};
+
+
+
+/**
+ * @brief One case of the suite
+ */
+struct Case
+{
+	Kind   kind;
+	size_t n;
+	size_t batch_size; // 0 for GramSchmidtEngine::run, otherwise GramSchmidtEngine::run_batch
+};
+
+
+
+/**
+ * @brief Measurements of one case; times are per call, seconds
+ */
+struct CaseResult
+{
+	std::string name;
+	double      median;
+	double      ci_low;        // 95% confidence interval of the median
+	double      ci_high;
+	size_t      outlier_count; // trials rejected as outliers
+};
+
+
+
+
+
+void print_usage(void)
+{
+	std::cout << "Usage: regression [--baseline=FILE] [--save=FILE] [--threshold=T] [--trials=N]\n"
+	          << "  Runs a fixed suite of cases (engines x sizes x batch shapes) and prints the median time per call\n"
+	          << "  with its 95% confidence interval, after a warm-up and the rejection of outliers. With --baseline,\n"
+	          << "  compares each case with the stored one and exits with code 2 if any median is slower by more\n"
+	          << "  than T (a fraction, 0.10 by default) and the confidence intervals do not overlap. --save writes\n"
+	          << "  the results as a new baseline. Default: N = 15 trials per case.\n";
+	return;
+}
+
+
+
+
+
+Settings parse_settings(int const argc, char const *const *const argv)
+{
+	Settings settings;
+	for (int arg_i = 1; arg_i < argc; ++arg_i)
+	{
+		std::string const arg = argv[arg_i];
+		if (arg.rfind("--baseline=", 0) == 0)
+			settings.baseline_path = arg.substr(11);
+		else if (arg.rfind("--save=", 0) == 0)
+			settings.save_path = arg.substr(7);
+		else if (arg.rfind("--threshold=", 0) == 0)
+			settings.threshold = std::stod(arg.substr(12));
+		else if (arg.rfind("--trials=", 0) == 0)
+			settings.trial_count = std::max<size_t>(std::stoull(arg.substr(9)), 5);
+		else if ((arg == "--help") || (arg == "-h"))
+		{
+			print_usage();
+			std::exit(0);
+		}
+		else
+			throw std::runtime_error("Unknown argument '" + arg + "'.");
+	}
+	return settings;
+}
+
+
+
+
+
+// Suite
+
+
+
+
+
+/**
+ * @brief The fixed suite; changing it invalidates the stored baselines
+ */
+std::vector<Case> suite(void)
+{
+	std::vector<Case> cases;
+	for (Kind const kind : {Kind::automatic, Kind::vulkan, Kind::cpu})
+	{
+		for (size_t const n : {4, 16, 64, 256, 1024})
+			cases.push_back(Case{kind, n, 0});
+		for (auto const &shape : std::vector<std::pair<size_t, size_t>>{{4, 4096}, {16, 256}, {64, 16}})
+			cases.push_back(Case{kind, shape.first, shape.second});
+	}
+	return cases;
+}
+
+
+
+
+
+std::string case_name(Case const &test_case)
+{
+	std::string name = std::string(kind_name(test_case.kind)) + "/n=" + std::to_string(test_case.n);
+	if (test_case.batch_size > 0)
+		name += "/batch=" + std::to_string(test_case.batch_size);
+	return name;
+}
+
+
+
+
+
+// Statistics
+
+
+
+
+
+/**
+ * @brief Median of sorted values
+ */
+double median_of(std::vector<double> const &sorted)
+{
+	size_t const count = sorted.size();
+	return (count % 2 == 1) ? (sorted[count / 2]) : (0.5 * (sorted[count / 2 - 1] + sorted[count / 2]));
+}
+
+
+
+
+
+/**
+ * @brief Rejects outliers and summarises the trials
+ *
+ * Trials further than 3 scaled median absolute deviations from the median are rejected (the MAD
+ * is scaled by 1.4826 to estimate the standard deviation). The confidence interval of the median
+ * is given by the order statistics at ranks n/2 -+ 0.98 sqrt(n), which holds for any distribution.
+ */
+CaseResult summarise(std::string const &name, std::vector<double> trials)
+{
+	// 1. Reject the outliers
+	std::sort(trials.begin(), trials.end());
+	double const raw_median = median_of(trials);
+	std::vector<double> deviations;
+	for (double const trial : trials)
+		deviations.push_back(std::abs(trial - raw_median));
+	std::sort(deviations.begin(), deviations.end());
+	double const mad = 1.4826 * median_of(deviations);
+	std::vector<double> kept;
+	for (double const trial : trials)
+		if ((mad == 0.0) || (std::abs(trial - raw_median) <= 3.0 * mad))
+			kept.push_back(trial);
+
+	// 2. Median and its confidence interval
+	double const count     = kept.size();
+	double const half_band = 0.98 * std::sqrt(count);
+	size_t const low_i     = static_cast<size_t>(std::max(0.0, std::floor(count / 2.0 - half_band)));
+	size_t const high_i    = static_cast<size_t>(std::min(count - 1.0, std::ceil(count / 2.0 + half_band) - 1.0));
+	return CaseResult{name, median_of(kept), kept[low_i], kept[high_i], trials.size() - kept.size()};
+}
+
+
+
+
+
+// Baselines
+// The format is the JSON written by save_baseline; it is read back without a general JSON parser.
+
+
+
+
+
+void save_baseline(std::string const &path, std::vector<CaseResult> const &results)
+{
+	std::ofstream file(path);
+	if (file.fail())
+		throw std::runtime_error("File '" + path + "' cannot be written.");
+	file << "{\n\t\"cases\": [";
+	file << std::setprecision(9);
+	for (size_t result_i = 0; result_i < results.size(); ++result_i)
+		file << ((result_i == 0) ? ("\n") : (",\n"))
+		     << "\t\t{\"name\": \"" << results[result_i].name << "\", \"median\": " << results[result_i].median
+		     << ", \"ci_low\": " << results[result_i].ci_low << ", \"ci_high\": " << results[result_i].ci_high << "}";
+	file << "\n\t]\n}\n";
+	return;
+}
+
+
+
+
+
+/**
+ * @brief Reads a baseline written by save_baseline
+ *
+ * @return The results by case name.
+ */
+std::map<std::string, CaseResult> load_baseline(std::string const &path)
+{
+	std::ifstream file(path);
+	if (file.fail())
+		throw std::runtime_error("File '" + path + "' was not found.");
+	std::stringstream content;
+	content << file.rdbuf();
+	std::string const text = content.str();
+
+	// Each case is a flat object; its fields are looked up between its braces
+	auto const number_field = [&text](size_t const begin, size_t const end, std::string const &field)
+	{
+		size_t const field_i = text.find("\"" + field + "\"", begin);
+		if ((field_i == std::string::npos) || (field_i > end))
+			throw std::runtime_error("Baseline is malformed: a case has no '" + field + "'.");
+		return std::stod(text.substr(text.find(':', field_i) + 1));
+	};
+	std::map<std::string, CaseResult> baseline;
+	for (size_t begin = text.find("{\"name\""); begin != std::string::npos; begin = text.find("{\"name\"", begin + 1))
+	{
+		size_t const end        = text.find('}', begin);
+		size_t const name_begin = text.find('"', text.find(':', begin)) + 1;
+		std::string const name  = text.substr(name_begin, text.find('"', name_begin) - name_begin);
+		baseline[name] = CaseResult{name, number_field(begin, end, "median"), number_field(begin, end, "ci_low"), number_field(begin, end, "ci_high"), 0};
+	}
+	return baseline;
+}
+
+
+
+
+
+// Measurements
+
+
+
+
+
+/**
+ * @brief Times one case
+ *
+ * A warm-up call is followed by the choice of the number of calls per trial, so that a trial takes
+ * at least Settings::trial_time; each trial then yields the mean time per call.
+ */
+CaseResult measure(Case const &test_case, GramSchmidtEngine &engine, Settings const &settings)
+{
+	using Clock = std::chrono::steady_clock;
+	std::default_random_engine             generator(test_case.n);
+	std::vector<GramSchmidtEngine::Matrix> matrices;
+	for (size_t matrix_i = 0; matrix_i < std::max<size_t>(test_case.batch_size, 1); ++matrix_i)
+		matrices.push_back(random_matrix(test_case.n, generator));
+	auto const call = [&](void)
+	{
+		if (test_case.batch_size > 0)
+			engine.run_batch(matrices);
+		else
+			engine.run(matrices.front());
+	};
+
+	// 1. Warm up and choose the number of calls per trial
+	call();
+	auto const start_time = Clock::now();
+	call();
+	double const call_time  = std::chrono::duration<double>(Clock::now() - start_time).count();
+	size_t const call_count = std::max<size_t>(1, static_cast<size_t>(std::ceil(settings.trial_time / std::max(call_time, 1.0e-9))));
+
+	// 2. Measure the trials
+	std::vector<double> trials;
+	for (size_t trial_i = 0; trial_i < settings.trial_count; ++trial_i)
+	{
+		auto const trial_start_time = Clock::now();
+		for (size_t call_i = 0; call_i < call_count; ++call_i)
+			call();
+		trials.push_back(std::chrono::duration<double>(Clock::now() - trial_start_time).count() / call_count);
+	}
+	return summarise(case_name(test_case), trials);
+}
+
+
+
+
+
+/**
+ * @brief Runs the suite and compares it with the baseline
+ *
+ * @return @c true if no case has regressed.
+ */
+bool benchmarking(Settings const &settings)
+{
+	// Set up a path to "shader_folder" that contains Gram-Schmidt SPIR-V compute shader
+	set_up_shader_folder();
+	std::map<std::string, CaseResult> const baseline = (settings.baseline_path.empty()) ? (std::map<std::string, CaseResult>()) : (load_baseline(settings.baseline_path));
+
+	// 1. Measure every available case. Times are in seconds per call; change is the relative
+	//    change of the median against the baseline.
+	std::vector<CaseResult> results;
+	size_t regression_count = 0;
+	std::cout << "case\tmedian\tci_low\tci_high\toutliers\tbaseline\tchange\tstatus\n";
+	std::cout << std::setprecision(4);
+	for (Case const &test_case : suite())
+	{
+		std::string              error;
+		GramSchmidtEngine *const engine = shared_engine(test_case.kind, error);
+		if (engine == nullptr)
+		{
+			std::cout << case_name(test_case) << "\t-\t-\t-\t-\t-\t-\tskipped: " << error << "\n";
+			continue;
+		}
+		CaseResult result;
+		try
+		{
+			result = measure(test_case, *engine, settings);
+		}
+		catch (std::exception const &exception)
+		{
+			std::cout << case_name(test_case) << "\t-\t-\t-\t-\t-\t-\tskipped: " << exception.what() << "\n";
+			continue;
+		}
+		results.push_back(result);
+		std::cout << result.name << '\t' << result.median << '\t' << result.ci_low << '\t' << result.ci_high << '\t' << result.outlier_count << '\t';
+		auto const reference = baseline.find(result.name);
+		if (reference == baseline.end())
+		{
+			std::cout << "-\t-\t" << (baseline.empty() ? "ok" : "new") << std::endl;
+			continue;
+		}
+		// 1.1. A case regresses if its median is slower than allowed and the slowdown is not noise
+		double const change    = result.median / reference->second.median - 1.0;
+		bool const   regressed = (change > settings.threshold) && (result.ci_low > reference->second.ci_high);
+		regression_count += regressed;
+		std::cout << reference->second.median << '\t' << std::showpos << 100.0 * change << '%' << std::noshowpos << '\t'
+		          << (regressed ? "REGRESSED" : ((change < -settings.threshold) && (result.ci_high < reference->second.ci_low)) ? "improved" : "ok") << std::endl;
+	}
+
+	// 2. Cases of the baseline that could not be run (no GPU, for example) are not failures
+	for (auto const &reference : baseline)
+		if (std::find_if(results.begin(), results.end(), [&reference](CaseResult const &result) { return result.name == reference.first; }) == results.end())
+			std::cout << "# " << reference.first << " is in the baseline but was not run\n";
+
+	if (!settings.save_path.empty())
+		save_baseline(settings.save_path, results);
+	std::cout << "# " << regression_count << " regression(s)\n";
+	return regression_count == 0;
+}
+
+
+
+
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		if (!benchmarking(parse_settings(argc, argv)))
+			return 2;
+	}
+	catch (std::exception &error)
+	{
+		std::cout << "ERROR! " << error.what() << "\n\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,322 @@
+/**
+ * @file roofline.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "common.hpp"
+#include <exception>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cstdlib>
+
+
+
+
+
+using Matrix = GPUGramSchmidt::Matrix;
+
+
+
+/**
+ * @brief Report settings, see print_usage
+ */
+struct Settings
+{
+	size_t                repetitions     = 3;
+	double                peak_flops      = 0.0; // FLOP/s, 0 means measured
+	double                peak_bandwidth  = 0.0; // bytes per second, 0 means measured
+	std::vector<uint32_t> workgroup_sizes = {32, 64, 128, 256};
+	std::vector<size_t>   orders          = {16, 32, 64, 128, 256, 512, 1024};
+	std::vector<size_t>   fixed_orders    = {2, 3, 4, 6, 8, 12, 16};
+	size_t                batch_size      = 16384;
+	bool                  pipeline_stats  = false;
+};
+
+
+
+/**
+ * @brief Amount of work the kernel has to do for one call
+ */
+struct Work
+{
+	double flops;
+	double bytes; // compulsory traffic between the kernel and the memory
+};
+
+
+
+
+
+void print_usage(void)
+{
+	std::cout << "Usage: roofline [--repetitions=R] [--peak-gflops=F] [--peak-gbps=B] [--work-groups=W1,W2,...] [--batch=M] [--pipeline-statistics] [orders...]\n"
+	          << "  For each kernel variant and order, prints the achieved GFLOP/s and GB/s of the GPU (the best of\n"
+	          << "  R calls, timed by GPU timestamps if possible), the arithmetic intensity, the attainable rate\n"
+	          << "  under the roofline and whether the case is compute- or memory-bound. The peaks are measured\n"
+	          << "  by probe kernels unless given (F in GFLOP/s, B in GB/s). Batches of M matrices of orders 2..16\n"
+	          << "  are run through the fixed-size kernel. With --pipeline-statistics, also prints what the driver\n"
+	          << "  compiled each work group size into (registers, spills, shared memory), if it supports\n"
+	          << "  VK_KHR_pipeline_executable_properties.\n"
+	          << "  Defaults: R = 3, W = 32,64,128,256, M = 16384, orders 16 32 64 128 256 512 1024.\n";
+	return;
+}
+
+
+
+
+
+Settings parse_settings(int const argc, char const *const *const argv)
+{
+	Settings settings;
+	std::vector<size_t> orders;
+	for (int arg_i = 1; arg_i < argc; ++arg_i)
+	{
+		std::string const arg = argv[arg_i];
+		if (arg.rfind("--repetitions=", 0) == 0)
+			settings.repetitions = std::max<size_t>(std::stoull(arg.substr(14)), 1);
+		else if (arg.rfind("--peak-gflops=", 0) == 0)
+			settings.peak_flops = std::stod(arg.substr(14)) * 1.0e9;
+		else if (arg.rfind("--peak-gbps=", 0) == 0)
+			settings.peak_bandwidth = std::stod(arg.substr(12)) * 1.0e9;
+		else if (arg.rfind("--work-groups=", 0) == 0)
+		{
+			std::stringstream workgroup_sizes(arg.substr(14));
+			std::string       workgroup_size;
+			settings.workgroup_sizes.clear();
+			while (std::getline(workgroup_sizes, workgroup_size, ','))
+				settings.workgroup_sizes.push_back(std::stoul(workgroup_size));
+		}
+		else if (arg.rfind("--batch=", 0) == 0)
+			settings.batch_size = std::stoull(arg.substr(8));
+		else if (arg == "--pipeline-statistics")
+			settings.pipeline_stats = true;
+		else if ((arg == "--help") || (arg == "-h"))
+		{
+			print_usage();
+			std::exit(0);
+		}
+		else
+			orders.push_back(std::stoull(arg));
+	}
+	if (!orders.empty())
+		settings.orders = orders;
+	return settings;
+}
+
+
+
+
+
+// Work models
+// Only the compulsory traffic is counted: whatever the kernel re-reads is assumed to hit the
+// caches. Achieved bandwidth is therefore a lower bound of the real one.
+
+
+
+
+
+/**
+ * @brief Work of GPUGramSchmidt::run on a matrix of order n
+ *
+ * Each step normalises one vector (3n flops) and projects it out of the remaining ones (4n flops
+ * each); the remaining vectors and the normalised one are read and written once per step.
+ */
+Work mgs_work(size_t const n)
+{
+	Work work{0.0, 0.0};
+	for (size_t start_vec_i = 0; start_vec_i < n; ++start_vec_i)
+	{
+		double const remaining_count = n - start_vec_i - 1;
+		work.flops += 3.0 * n + 4.0 * n * remaining_count;
+		work.bytes += 16.0 * n * (remaining_count + 1.0);
+	}
+	return work;
+}
+
+
+
+
+
+/**
+ * @brief Work of the fixed-size kernel on one matrix of order n
+ *
+ * The whole matrix stays in registers, so it is read and written once.
+ */
+Work fixed_work(size_t const n)
+{
+	Work work{0.0, 16.0 * n * n};
+	for (size_t curr_vec_i = 0; curr_vec_i < n; ++curr_vec_i)
+		work.flops += 4.0 * n * curr_vec_i + 3.0 * n;
+	return work;
+}
+
+
+
+
+
+// Report
+
+
+
+
+
+/**
+ * @brief GPU time of a call: timestamps if they were recorded, the host view of the computations
+ * otherwise
+ */
+double gpu_time(GPUGramSchmidt::RunStats const &stats)
+{
+	return (stats.gpu_compute_time > 0.0) ? (stats.gpu_compute_time) : (stats.compute_time);
+}
+
+
+
+
+
+void print_case(std::string const &kernel, size_t const n, size_t const matrix_count, Work const &work, double const time, GPUGramSchmidt::DeviceLimits const &limits)
+{
+	double const intensity  = work.flops / work.bytes;
+	double const attainable = std::min(limits.fp64_flops, intensity * limits.bandwidth);
+	double const achieved   = work.flops / time;
+	bool const   memory     = intensity * limits.bandwidth < limits.fp64_flops;
+	std::cout << kernel << '\t' << n << '\t' << matrix_count << '\t' << std::setprecision(4) << time << '\t'
+	          << achieved * 1.0e-9 << '\t' << work.bytes / time * 1.0e-9 << '\t' << intensity << '\t'
+	          << attainable * 1.0e-9 << '\t' << 100.0 * achieved / attainable << "%\t" << (memory ? "memory" : "compute") << std::endl;
+	return;
+}
+
+
+
+
+
+/**
+ * @brief Prints the statistics of the executables of a kernel as comments, one line per executable
+ */
+void print_pipeline_statistics(std::string const &kernel, std::vector<GPUGramSchmidt::PipelineExecutable> const &executables)
+{
+	if (executables.empty())
+		std::cout << "# " << kernel << " statistics: not supported by the driver\n";
+	for (auto const &executable : executables)
+	{
+		std::cout << "# " << kernel << " statistics of '" << executable.name << "' (subgroup " << executable.subgroup_size << "):";
+		for (auto const &statistic : executable.statistics)
+			std::cout << ' ' << statistic.name << '=' << statistic.value << ';';
+		std::cout << '\n';
+	}
+	return;
+}
+
+
+
+
+
+void benchmarking(Settings const &settings)
+{
+	// Set up a path to "shader_folder" that contains Gram-Schmidt SPIR-V compute shader
+	set_up_shader_folder();
+	GPUGramSchmidt vgs(false, false, GPUGramSchmidt::Backend::gpu);
+	vgs.set_gpu_timing(true);
+	std::default_random_engine generator(0);
+
+	// 1. The roofs: measured, unless given
+	GPUGramSchmidt::DeviceLimits limits{settings.peak_flops, settings.peak_bandwidth};
+	if ((limits.fp64_flops == 0.0) || (limits.bandwidth == 0.0))
+	{
+		GPUGramSchmidt::DeviceLimits const measured = vgs.measure_device_limits();
+		if (limits.fp64_flops == 0.0)
+			limits.fp64_flops = measured.fp64_flops;
+		if (limits.bandwidth == 0.0)
+			limits.bandwidth = measured.bandwidth;
+	}
+	std::cout << "# device: " << vgs.get_device_name() << "\n"
+	          << "# peak fp64: " << limits.fp64_flops * 1.0e-9 << " GFLOP/s (" << ((settings.peak_flops == 0.0) ? "measured" : "given") << ")\n"
+	          << "# peak bandwidth: " << limits.bandwidth * 1.0e-9 << " GB/s (" << ((settings.peak_bandwidth == 0.0) ? "measured" : "given") << ")\n"
+	          << "# ridge point: " << limits.fp64_flops / limits.bandwidth << " FLOP/byte\n"
+	          << "# timing: " << (vgs.get_gpu_timing() ? "GPU timestamps" : "host clock, includes the submission overhead") << "\n";
+
+	// 2. Each work group size of the per-step kernel. Times are in seconds per call, intensity is
+	//    in FLOP/byte, efficiency is the achieved rate against the attainable one.
+	std::cout << "kernel\tn\tmatrices\ttime\tGFLOP/s\tGB/s\tintensity\tattainable\tefficiency\tbound\n";
+	for (uint32_t const workgroup_size : settings.workgroup_sizes)
+	{
+		std::string const kernel = "mgs/wg=" + std::to_string(workgroup_size);
+		try
+		{
+			vgs.set_variant(GPUGramSchmidt::Variant{.workgroup_size = workgroup_size});
+		}
+		catch (std::exception const &error)
+		{
+			std::cout << "# " << kernel << " skipped: " << error.what() << "\n";
+			continue;
+		}
+		if (settings.pipeline_stats)
+			print_pipeline_statistics(kernel, vgs.get_pipeline_statistics(vgs.get_variant()));
+		for (size_t const n : settings.orders)
+		{
+			Matrix matrix = random_matrix(n, generator);
+			double time   = std::numeric_limits<double>::infinity();
+			vgs.run(matrix); // warm-up: memory
+			for (size_t repeat_i = 0; repeat_i < settings.repetitions; ++repeat_i)
+			{
+				GPUGramSchmidt::RunStats stats;
+				vgs.run(matrix, false, &stats);
+				time = std::min(time, gpu_time(stats));
+			}
+			print_case(kernel, n, 1, mgs_work(n), time, limits);
+		}
+	}
+
+	// 3. The fixed-size kernel, one dispatch per batch
+	for (size_t const n : settings.fixed_orders)
+	{
+		std::vector<Matrix> matrices;
+		for (size_t matrix_i = 0; matrix_i < settings.batch_size; ++matrix_i)
+			matrices.push_back(random_matrix(n, generator));
+		double time = std::numeric_limits<double>::infinity();
+		try
+		{
+			vgs.run_batch(matrices); // warm-up: pipeline, memory
+			for (size_t repeat_i = 0; repeat_i < settings.repetitions; ++repeat_i)
+			{
+				GPUGramSchmidt::RunStats stats;
+				vgs.run_batch(matrices, false, &stats);
+				time = std::min(time, gpu_time(stats));
+			}
+		}
+		catch (std::exception const &error)
+		{
+			std::cout << "# fixed skipped: " << error.what() << "\n";
+			break;
+		}
+		Work work = fixed_work(n);
+		work.flops *= settings.batch_size;
+		work.bytes *= settings.batch_size;
+		print_case("fixed", n, settings.batch_size, work, time, limits);
+	}
+	return;
+}
+
+
+
+
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		benchmarking(parse_settings(argc, argv));
+	}
+	catch (std::exception &error)
+	{
+		std::cout << "ERROR! " << error.what() << "\n\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,312 @@
+/**
+ * @file scaling.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "common.hpp"
+#include <exception>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cstdlib>
+
+
+
+
+
+using Matrix  = GPUGramSchmidt::Matrix;
+using Backend = GPUGramSchmidt::Backend;
+using Clock   = std::chrono::steady_clock;
+
+
+
+/**
+ * @brief Benchmark settings, see print_usage
+ */
+struct Settings
+{
+	Backend             backend       = Backend::automatic;
+	std::vector<size_t> thread_counts = {1, 2, 4, 8};
+	std::vector<size_t> solver_counts = {1, 2, 4};
+	size_t              n             = 64;
+	size_t              batch_size    = 0;   // 0 for GPUGramSchmidt::run, otherwise GPUGramSchmidt::run_batch
+	double              duration      = 1.0; // seconds per configuration
+};
+
+
+
+/**
+ * @brief Solvers of one configuration
+ */
+struct SolverSet
+{
+	std::vector<std::unique_ptr<GPUGramSchmidt>> solvers;
+	std::unique_ptr<std::mutex[]>                locks;             // one per solver, a solver runs one request at a time
+	double                                       construction_time; // wall time to construct all the solvers concurrently
+	size_t                                       gpu_count;         // solvers that got a GPU queue
+	size_t                                       device_count;      // distinct GPUs among them (by name)
+};
+
+
+
+
+
+void print_usage(void)
+{
+	std::cout << "Usage: scaling [--backend=automatic|gpu|cpu|hybrid] [--threads=T1,T2,...] [--solvers=S1,S2,...] [--order=N] [--batch=B] [--duration=D]\n"
+	          << "  For each number of solvers S, constructs S solvers concurrently. Each takes its own queue,\n"
+	          << "  spilling over to the next GPU once the queues of one are taken. Then, for each number of\n"
+	          << "  client threads T, the threads issue requests for D seconds, thread t to solver t mod S.\n"
+	          << "  Prints the aggregate throughput and the latency percentiles. A request is one matrix of\n"
+	          << "  order N, or a batch of B of them.\n"
+	          << "  Defaults: T = 1,2,4,8, S = 1,2,4, N = 64, one matrix per request, D = 1.\n";
+	return;
+}
+
+
+
+
+
+std::vector<size_t> parse_list(std::string const &list)
+{
+	std::stringstream   items(list);
+	std::string         item;
+	std::vector<size_t> values;
+	while (std::getline(items, item, ','))
+		values.push_back(std::max<size_t>(std::stoull(item), 1));
+	return values;
+}
+
+
+
+
+
+Settings parse_settings(int const argc, char const *const *const argv)
+{
+	Settings settings;
+	for (int arg_i = 1; arg_i < argc; ++arg_i)
+	{
+		std::string const arg = argv[arg_i];
+		if (parse_backend(arg, settings.backend))
+			continue;
+		if (arg.rfind("--threads=", 0) == 0)
+			settings.thread_counts = parse_list(arg.substr(10));
+		else if (arg.rfind("--solvers=", 0) == 0)
+			settings.solver_counts = parse_list(arg.substr(10));
+		else if (arg.rfind("--order=", 0) == 0)
+			settings.n = std::max<size_t>(std::stoull(arg.substr(8)), 2);
+		else if (arg.rfind("--batch=", 0) == 0)
+			settings.batch_size = std::stoull(arg.substr(8));
+		else if (arg.rfind("--duration=", 0) == 0)
+			settings.duration = std::stod(arg.substr(11));
+		else if ((arg == "--help") || (arg == "-h"))
+		{
+			print_usage();
+			std::exit(0);
+		}
+		else
+			throw std::runtime_error("Unknown argument '" + arg + "'.");
+	}
+	return settings;
+}
+
+
+
+
+
+// Measurements
+
+
+
+
+
+/**
+ * @brief Constructs the solvers from as many threads at once
+ *
+ * @throw std::runtime_error If a solver cannot be constructed (e.g. no free queue with Backend::gpu).
+ */
+SolverSet construct_solvers(size_t const solver_count, Backend const backend)
+{
+	SolverSet set;
+	set.solvers.resize(solver_count);
+	set.locks.reset(new std::mutex[solver_count]);
+	std::vector<std::string> errors(solver_count);
+
+	// 1. All the constructors are started together; GPUGramSchmidt serialises part of them
+	auto const start_time = Clock::now();
+	std::vector<std::thread> threads;
+	for (size_t solver_i = 0; solver_i < solver_count; ++solver_i)
+		threads.emplace_back([&set, &errors, solver_i, backend](void)
+		{
+			try
+			{
+				set.solvers[solver_i].reset(new GPUGramSchmidt(false, false, backend));
+			}
+			catch (std::exception const &error)
+			{
+				errors[solver_i] = error.what();
+			}
+		});
+	for (auto &thread : threads)
+		thread.join();
+	set.construction_time = std::chrono::duration<double>(Clock::now() - start_time).count();
+	for (auto const &error : errors)
+		if (!error.empty())
+			throw std::runtime_error(error);
+
+	// 2. See where the solvers have landed
+	std::set<std::string> device_names;
+	set.gpu_count = 0;
+	for (auto const &solver : set.solvers)
+		if (solver->get_backend() != Backend::cpu)
+		{
+			++set.gpu_count;
+			device_names.insert(solver->get_device_name());
+		}
+	set.device_count = device_names.size();
+	return set;
+}
+
+
+
+
+
+/**
+ * @brief Value below which the given share of the sorted latencies lies (nearest rank)
+ */
+double percentile(std::vector<double> const &sorted, double const share)
+{
+	size_t const rank = static_cast<size_t>(std::ceil(share * sorted.size()));
+	return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+
+
+
+
+/**
+ * @brief Runs the clients against the solvers and prints one row
+ */
+void run_clients(SolverSet &set, size_t const thread_count, Settings const &settings)
+{
+	size_t const                     solver_count = set.solvers.size();
+	std::vector<std::vector<double>> latencies(thread_count);
+	std::atomic<bool>                start(false);
+	Clock::time_point                deadline;
+
+	// 1. Every client has its own matrices and waits for the common start
+	std::vector<std::thread> threads;
+	for (size_t thread_i = 0; thread_i < thread_count; ++thread_i)
+		threads.emplace_back([&, thread_i](void)
+		{
+			std::default_random_engine generator(thread_i);
+			std::vector<Matrix>        matrices;
+			for (size_t matrix_i = 0; matrix_i < std::max<size_t>(settings.batch_size, 1); ++matrix_i)
+				matrices.push_back(random_matrix(settings.n, generator));
+			GPUGramSchmidt &solver = *set.solvers[thread_i % solver_count];
+			std::mutex     &lock   = set.locks[thread_i % solver_count];
+			while (!start)
+				std::this_thread::yield();
+
+			// 2. Latency is seen from the client: it includes waiting for a solver busy with
+			//    the requests of the other clients
+			while (Clock::now() < deadline)
+			{
+				auto const request_start_time = Clock::now();
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					if (settings.batch_size > 0)
+						solver.run_batch(matrices);
+					else
+						solver.run(matrices.front());
+				}
+				latencies[thread_i].push_back(std::chrono::duration<double>(Clock::now() - request_start_time).count());
+			}
+		});
+	auto const start_time = Clock::now();
+	deadline = start_time + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(settings.duration));
+	start = true;
+	for (auto &thread : threads)
+		thread.join();
+	double const wall_time = std::chrono::duration<double>(Clock::now() - start_time).count();
+
+	// 3. Aggregate over the clients
+	std::vector<double> all_latencies;
+	for (auto const &thread_latencies : latencies)
+		all_latencies.insert(all_latencies.end(), thread_latencies.begin(), thread_latencies.end());
+	std::sort(all_latencies.begin(), all_latencies.end());
+	double const matrix_count = static_cast<double>(all_latencies.size()) * std::max<size_t>(settings.batch_size, 1);
+	double const n            = settings.n;
+	std::cout << thread_count << '\t' << solver_count << '\t' << set.gpu_count << '\t' << set.device_count << '\t'
+	          << std::setprecision(4) << set.construction_time << '\t' << all_latencies.size() << '\t'
+	          << all_latencies.size() / wall_time << '\t' << 2.0 * n * n * n * matrix_count / wall_time * 1.0e-9;
+	if (all_latencies.empty())
+		std::cout << "\t-\t-\t-\t-\n";
+	else
+		std::cout << '\t' << percentile(all_latencies, 0.5) << '\t' << percentile(all_latencies, 0.9) << '\t'
+		          << percentile(all_latencies, 0.99) << '\t' << all_latencies.back() << std::endl;
+	return;
+}
+
+
+
+
+
+void benchmarking(Settings const &settings)
+{
+	// Set up a path to "shader_folder" that contains Gram-Schmidt SPIR-V compute shader
+	set_up_shader_folder();
+
+	// Times are in seconds; throughput is in requests per second; gpu_solvers is the number of
+	// solvers that got a GPU queue, devices the number of distinct GPUs among them
+	std::cout << "threads\tsolvers\tgpu_solvers\tdevices\tconstruction\trequests\tthroughput\tGFLOP/s\tp50\tp90\tp99\tmax\n";
+	for (size_t const solver_count : settings.solver_counts)
+	{
+		SolverSet set;
+		try
+		{
+			set = construct_solvers(solver_count, settings.backend);
+		}
+		catch (std::exception const &error)
+		{
+			std::cout << "# " << solver_count << " solver(s) skipped: " << error.what() << "\n";
+			continue;
+		}
+		// Calibration of Backend::automatic and the first allocations are not part of the load
+		for (auto const &solver : set.solvers)
+			solver->warm_up({settings.n});
+		for (size_t const thread_count : settings.thread_counts)
+			run_clients(set, thread_count, settings);
+	}
+	return;
+}
+
+
+
+
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		benchmarking(parse_settings(argc, argv));
+	}
+	catch (std::exception &error)
+	{
+		std::cout << "ERROR! " << error.what() << "\n\n";
+		return 1;
+	}
+
+	return 0;
+}
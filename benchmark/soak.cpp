@@ -0,0 +1,270 @@
+/**
+ * @file soak.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "common.hpp"
+#include <exception>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdlib>
+#include <unistd.h>
+
+
+
+
+
+using Matrix  = GPUGramSchmidt::Matrix;
+using Backend = GPUGramSchmidt::Backend;
+using Clock   = std::chrono::steady_clock;
+
+
+
+/**
+ * @brief Soak settings, see print_usage
+ */
+struct Settings
+{
+	Backend             backend          = Backend::automatic;
+	uint64_t            call_count       = 1000000;
+	double              duration         = 0.0;   // seconds, 0 means no limit
+	uint64_t            sample_interval  = 10000; // calls per sample
+	std::vector<size_t> orders           = {2, 3, 4, 8, 16, 32, 64, 128, 256};
+	double              memory_tolerance = 0.05;  // allowed relative growth of the memory
+	double              drift_tolerance  = 0.25;  // allowed relative growth of the median latency
+};
+
+
+
+/**
+ * @brief State of the process after a number of calls
+ */
+struct Sample
+{
+	uint64_t call_count;
+	double   elapsed_time;
+	uint64_t rss;              // resident set of the process, bytes
+	uint64_t heap_usage;       // device memory used by the process, bytes
+	uint64_t matrix_buffer;    // bytes
+	uint32_t allocation_count; // Vulkan memory allocations since the start
+	double   median_latency;   // of the calls since the previous sample, seconds
+	double   p99_latency;
+};
+
+
+
+
+
+void print_usage(void)
+{
+	std::cout << "Usage: soak [--backend=automatic|gpu|cpu|hybrid] [--calls=N] [--duration=D] [--sample=K] [--orders=N1,N2,...] [--memory-tolerance=M] [--drift-tolerance=L]\n"
+	          << "  Makes N calls to GPUGramSchmidt::run (or as many as fit into D seconds) on matrices of random\n"
+	          << "  orders from the list. Every K calls, prints the resident memory of the process, the device\n"
+	          << "  memory in use (with VK_EXT_memory_budget), the matrix buffer, the number of Vulkan memory\n"
+	          << "  allocations and the latency of the last K calls. At the end, compares the last sample with the\n"
+	          << "  first one and exits with code 2 if the memory grew by more than M (relative), the allocations\n"
+	          << "  grew at all or the median latency grew by more than L.\n"
+	          << "  Defaults: N = 1000000, no time limit, K = 10000, orders 2 3 4 8 16 32 64 128 256, M = 0.05, L = 0.25.\n";
+	return;
+}
+
+
+
+
+
+Settings parse_settings(int const argc, char const *const *const argv)
+{
+	Settings settings;
+	for (int arg_i = 1; arg_i < argc; ++arg_i)
+	{
+		std::string const arg = argv[arg_i];
+		if (parse_backend(arg, settings.backend))
+			continue;
+		if (arg.rfind("--calls=", 0) == 0)
+			settings.call_count = std::stoull(arg.substr(8));
+		else if (arg.rfind("--duration=", 0) == 0)
+			settings.duration = std::stod(arg.substr(11));
+		else if (arg.rfind("--sample=", 0) == 0)
+			settings.sample_interval = std::max<uint64_t>(std::stoull(arg.substr(9)), 1);
+		else if (arg.rfind("--orders=", 0) == 0)
+		{
+			std::stringstream orders(arg.substr(9));
+			std::string       order;
+			settings.orders.clear();
+			while (std::getline(orders, order, ','))
+				settings.orders.push_back(std::max<size_t>(std::stoull(order), 2));
+		}
+		else if (arg.rfind("--memory-tolerance=", 0) == 0)
+			settings.memory_tolerance = std::stod(arg.substr(19));
+		else if (arg.rfind("--drift-tolerance=", 0) == 0)
+			settings.drift_tolerance = std::stod(arg.substr(18));
+		else if ((arg == "--help") || (arg == "-h"))
+		{
+			print_usage();
+			std::exit(0);
+		}
+		else
+			throw std::runtime_error("Unknown argument '" + arg + "'.");
+	}
+	if (settings.orders.empty())
+		throw std::runtime_error("The list of orders must not be empty.");
+	return settings;
+}
+
+
+
+
+
+// Sampling
+
+
+
+
+
+/**
+ * @brief Resident set of the process, bytes (0 where /proc is not available)
+ */
+uint64_t resident_memory(void)
+{
+	std::ifstream statm("/proc/self/statm");
+	uint64_t      total_pages    = 0;
+	uint64_t      resident_pages = 0;
+	if (!(statm >> total_pages >> resident_pages))
+		return 0;
+	return resident_pages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+
+
+
+
+Sample take_sample(GPUGramSchmidt const &vgs, uint64_t const call_count, double const elapsed_time, std::vector<double> &latencies)
+{
+	GPUGramSchmidt::DeviceMemoryUsage const device_memory = vgs.get_device_memory_usage();
+	Sample sample{call_count, elapsed_time, resident_memory(), device_memory.heap_usage, device_memory.matrix_buffer, vgs.get_total_stats().allocation_count, 0.0, 0.0};
+	if (!latencies.empty())
+	{
+		std::sort(latencies.begin(), latencies.end());
+		sample.median_latency = latencies[latencies.size() / 2];
+		sample.p99_latency    = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+	}
+	latencies.clear();
+	return sample;
+}
+
+
+
+
+
+void print_sample(Sample const &sample)
+{
+	std::cout << sample.call_count << '\t' << std::setprecision(4) << sample.elapsed_time << '\t'
+	          << sample.rss / 1048576.0 << '\t' << sample.heap_usage / 1048576.0 << '\t' << sample.matrix_buffer / 1048576.0 << '\t'
+	          << sample.allocation_count << '\t' << sample.median_latency << '\t' << sample.p99_latency << std::endl;
+	return;
+}
+
+
+
+
+
+/**
+ * @brief Compares a quantity at the end of the run with its value at the start
+ *
+ * @return @c true if it grew by more than the tolerance.
+ */
+bool grew(std::string const &name, double const first, double const last, double const tolerance)
+{
+	bool const growth = last > first * (1.0 + tolerance);
+	std::cout << "# " << name << ": " << first << " -> " << last << ((growth) ? ("  GROWTH") : ("")) << "\n";
+	return growth;
+}
+
+
+
+
+
+bool benchmarking(Settings const &settings)
+{
+	// Set up a path to "shader_folder" that contains Gram-Schmidt SPIR-V compute shader
+	set_up_shader_folder();
+	GPUGramSchmidt vgs(false, false, settings.backend);
+	vgs.warm_up(settings.orders);
+
+	// 1. One matrix per order
+	std::default_random_engine            generator(0);
+	std::uniform_int_distribution<size_t> pick_order(0, settings.orders.size() - 1);
+	std::vector<Matrix>                   matrices;
+	for (size_t const n : settings.orders)
+		matrices.push_back(random_matrix(n, generator));
+
+	// 2. Run and sample. Memory is in MiB, latencies are in seconds.
+	std::cout << "calls\telapsed\trss\tdevice_usage\tmatrix_buffer\tallocations\tp50\tp99\n";
+	std::vector<Sample> samples;
+	std::vector<double> latencies;
+	auto const          start_time = Clock::now();
+	uint64_t            call_i     = 0;
+	for (; call_i < settings.call_count; ++call_i)
+	{
+		auto const call_start_time = Clock::now();
+		vgs.run(matrices[pick_order(generator)]);
+		auto const call_end_time = Clock::now();
+		latencies.push_back(std::chrono::duration<double>(call_end_time - call_start_time).count());
+		if ((call_i + 1) % settings.sample_interval == 0)
+		{
+			double const elapsed_time = std::chrono::duration<double>(call_end_time - start_time).count();
+			samples.push_back(take_sample(vgs, call_i + 1, elapsed_time, latencies));
+			print_sample(samples.back());
+			if ((settings.duration > 0.0) && (elapsed_time >= settings.duration))
+			{
+				++call_i;
+				break;
+			}
+		}
+	}
+
+	// 3. Compare the last sample with the first one; the first one is taken once the solver is in
+	//    the steady state, since all the orders were warmed up
+	if (samples.size() < 2)
+	{
+		std::cout << "# too few samples to look for growth: make more calls or sample more often\n";
+		return true;
+	}
+	Sample const &first  = samples.front();
+	Sample const &last   = samples.back();
+	bool          growth = false;
+	growth |= grew("rss, MiB", first.rss / 1048576.0, last.rss / 1048576.0, settings.memory_tolerance);
+	growth |= grew("device usage, MiB", first.heap_usage / 1048576.0, last.heap_usage / 1048576.0, settings.memory_tolerance);
+	growth |= grew("matrix buffer, MiB", first.matrix_buffer / 1048576.0, last.matrix_buffer / 1048576.0, 0.0);
+	growth |= grew("allocations", first.allocation_count, last.allocation_count, 0.0);
+	growth |= grew("median latency, s", first.median_latency, last.median_latency, settings.drift_tolerance);
+	std::cout << "# " << call_i << " calls, " << ((growth) ? ("growth detected") : ("no growth")) << "\n";
+	return !growth;
+}
+
+
+
+
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		if (!benchmarking(parse_settings(argc, argv)))
+			return 2;
+	}
+	catch (std::exception &error)
+	{
+		std::cout << "ERROR! " << error.what() << "\n\n";
+		return 1;
+	}
+
+	return 0;
+}
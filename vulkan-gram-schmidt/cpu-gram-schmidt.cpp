@@ -0,0 +1,329 @@
+/**
+ * @file cpu-gram-schmidt.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "cpu-gram-schmidt.hpp"
+#include "host-kernels.hpp"
+#include "fixed-gram-schmidt.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <thread>
+
+
+
+
+
+// Initialisation of static members
+size_t CPUGramSchmidt::block_size = 32;
+
+
+
+
+
+// Helpers
+
+
+
+
+
+/**
+ * Projections that take fewer multiply-adds than this are not split into tasks
+ */
+static size_t const min_task_work = size_t(1) << 15;
+
+
+
+
+
+/**
+ * @brief Pool of the given size shared by all the solvers of the process
+ *
+ * Every GPUGramSchmidt keeps a CPU solver for small matrices and fallbacks; without sharing, each
+ * of them would start a full set of workers. The pool is stopped with the last solver using it.
+ *
+ * @param thread_count Total number of threads, 0 means as many as there are hardware threads.
+ */
+static std::shared_ptr<vgs::ThreadPool> shared_pool(uint32_t const thread_count)
+{
+	static std::mutex                                         pools_lock;
+	static std::map<uint32_t, std::weak_ptr<vgs::ThreadPool>> pools; // by total number of threads
+	uint32_t const total_count = (thread_count > 0) ? (thread_count) : (std::max(1U, std::thread::hardware_concurrency()));
+	std::lock_guard<std::mutex> guard(pools_lock);
+	std::shared_ptr<vgs::ThreadPool> pool = pools[total_count].lock();
+	if (pool == nullptr)
+	{
+		pool = std::make_shared<vgs::ThreadPool>(total_count);
+		pools[total_count] = pool;
+	}
+	return pool;
+}
+
+
+
+
+
+/**
+ * @brief Packs the vectors of a matrix one after another
+ *
+ * @param matrix Square matrix with the coordinates of the vectors.
+ * @param vectors_as_columns Indicates whether vectors are stored as columns or as rows.
+ * @param vectors Destination of \f$n^2\f$ coordinates.
+ * @param first_vec_i First vector to pack.
+ * @param last_vec_i Vector after the last one to pack.
+ */
+static void pack(CPUGramSchmidt::Matrix const &matrix, bool const vectors_as_columns, double *const vectors, size_t const first_vec_i, size_t const last_vec_i)
+{
+	size_t const n = matrix.size();
+	for (size_t i = first_vec_i; i < last_vec_i; ++i)
+		for (size_t j = 0; j < n; ++j)
+			vectors[i * n + j] = vectors_as_columns ? matrix[j][i] : matrix[i][j];
+	return;
+}
+
+
+
+
+
+/**
+ * @brief Reads packed vectors back into a matrix
+ *
+ * @param vectors Source of \f$n^2\f$ coordinates.
+ * @param vectors_as_columns Indicates whether vectors are stored as columns or as rows.
+ * @param matrix Square matrix to write the coordinates to.
+ * @param first_vec_i First vector to read.
+ * @param last_vec_i Vector after the last one to read.
+ */
+static void unpack(double const *const vectors, bool const vectors_as_columns, CPUGramSchmidt::Matrix &matrix, size_t const first_vec_i, size_t const last_vec_i)
+{
+	size_t const n = matrix.size();
+	for (size_t i = first_vec_i; i < last_vec_i; ++i)
+		for (size_t j = 0; j < n; ++j)
+			matrix[vectors_as_columns ? j : i][vectors_as_columns ? i : j] = vectors[i * n + j];
+	return;
+}
+
+
+
+
+
+/**
+ * @brief Removes the components along orthonormal vectors from a vector one by one (MGS)
+ *
+ * @param basis First of the orthonormal vectors, stored one after another.
+ * @param basis_count Number of the orthonormal vectors.
+ * @param vector Vector to clean.
+ * @param dim Number of coordinates of each vector.
+ */
+static void project_out_sequential(double const *const basis, size_t const basis_count, double *const vector, size_t const dim)
+{
+	for (size_t basis_i = 0; basis_i < basis_count; ++basis_i)
+		vgs::axpy(-vgs::dot(basis + basis_i * dim, vector, dim), basis + basis_i * dim, vector, dim);
+	return;
+}
+
+
+
+
+
+/**
+ * @brief Removes the components along orthonormal vectors from a vector all at once (CGS)
+ *
+ * All the projections are computed before any of them is subtracted. The basis is processed
+ * in chunks of 64 vectors to keep the coefficients on the stack.
+ *
+ * @param basis First of the orthonormal vectors, stored one after another.
+ * @param basis_count Number of the orthonormal vectors.
+ * @param vector Vector to clean.
+ * @param dim Number of coordinates of each vector.
+ */
+static void project_out_classical(double const *const basis, size_t const basis_count, double *const vector, size_t const dim)
+{
+	size_t const chunk_size = 64;
+	double coefficients[chunk_size];
+	for (size_t chunk_begin = 0; chunk_begin < basis_count; chunk_begin += chunk_size)
+	{
+		size_t const chunk_end = std::min(chunk_begin + chunk_size, basis_count);
+		for (size_t basis_i = chunk_begin; basis_i < chunk_end; ++basis_i)
+			coefficients[basis_i - chunk_begin] = vgs::dot(basis + basis_i * dim, vector, dim);
+		for (size_t basis_i = chunk_begin; basis_i < chunk_end; ++basis_i)
+			vgs::axpy(-coefficients[basis_i - chunk_begin], basis + basis_i * dim, vector, dim);
+	}
+	return;
+}
+
+
+
+
+
+// Constructors & destructors
+
+
+
+
+
+CPUGramSchmidt::CPUGramSchmidt(uint32_t const thread_count, CPUGramSchmidt::Algorithm const algorithm) :
+	pool(shared_pool(thread_count)),
+	algorithm(algorithm)
+{}
+
+
+
+
+
+// Computations
+
+
+
+
+
+void CPUGramSchmidt::run(CPUGramSchmidt::Matrix &matrix, bool const vectors_as_columns)
+{
+	size_t const n = matrix.size();
+	if (n == 0)
+		return;
+
+	// 0. Tiny matrices are done on the stack by the calling thread
+	if (n <= vgs::max_fixed_dim)
+	{
+		double vectors[vgs::max_fixed_dim * vgs::max_fixed_dim];
+		pack(matrix, vectors_as_columns, vectors, 0, n);
+		this->orthonormalise(vectors, n, n);
+		unpack(vectors, vectors_as_columns, matrix, 0, n);
+		return;
+	}
+
+	// 1. Pack the vectors one after another. The buffer is left uninitialised and packed by all
+	//    the threads, so that on NUMA machines its pages are spread over the nodes of the threads
+	//    that will be cleaning the vectors instead of being placed next to the calling thread.
+	std::unique_ptr<double[]> const vectors(new double[n * n]);
+	size_t const grain = std::max(n / (4 * this->pool->size()), (min_task_work + n - 1) / n);
+	this->pool->parallel_for(0, n, grain, [&](size_t const first_vec_i, size_t const last_vec_i)
+	{
+		pack(matrix, vectors_as_columns, vectors.get(), first_vec_i, last_vec_i);
+	});
+
+	// 2. Orthonormalise them
+	this->orthonormalise(vectors.get(), n, n);
+
+	// 3. Read the result into the original matrix
+	this->pool->parallel_for(0, n, grain, [&](size_t const first_vec_i, size_t const last_vec_i)
+	{
+		unpack(vectors.get(), vectors_as_columns, matrix, first_vec_i, last_vec_i);
+	});
+	
+	return;
+}
+
+
+
+
+
+void CPUGramSchmidt::run_batch(std::vector<CPUGramSchmidt::Matrix> &matrices, bool const vectors_as_columns)
+{
+	// 1. Order the matrices from the largest to the smallest. Tasks are stolen from the front
+	//    of a queue, so the large ones get started first, and the small ones fill the gaps
+	//    at the end.
+	std::vector<size_t> order(matrices.size());
+	for (size_t matrix_i = 0; matrix_i < matrices.size(); ++matrix_i)
+		order[matrix_i] = matrix_i;
+	std::stable_sort(order.begin(), order.end(), [&matrices](size_t const a, size_t const b) { return matrices[a].size() > matrices[b].size(); });
+
+	// 2. One task per matrix; panels of the large ones are split into tasks by project_out
+	this->pool->parallel_for(0, order.size(), 1, [&](size_t const first_i, size_t const last_i)
+	{
+		for (size_t i = first_i; i < last_i; ++i)
+		{
+			CPUGramSchmidt::Matrix &matrix = matrices[order[i]];
+			size_t const n = matrix.size();
+			if (n == 0)
+				continue;
+			// The buffer is first touched here, so its pages are placed next to the executing thread
+			std::vector<double> vectors(n * n);
+			pack(matrix, vectors_as_columns, vectors.data(), 0, n);
+			this->orthonormalise(vectors.data(), n, n);
+			unpack(vectors.data(), vectors_as_columns, matrix, 0, n);
+		}
+	});
+	return;
+}
+
+
+
+
+
+void CPUGramSchmidt::orthonormalise(double *const vectors, size_t const vector_count, size_t const dim)
+{
+	// Vectors are processed block by block. With MGS, every vector is cleaned of the components
+	// along each of the previous vectors one by one, as soon as they are ready. With CGS2, every
+	// vector is cleaned of the components along each finished block at once (first pass), and
+	// then once again of the components along all previous blocks right before the vector's own
+	// block is orthonormalised (second pass).
+	if ((vector_count == dim) && (vgs::orthonormalise_fixed(vectors, dim)))
+		return;
+	size_t const block_size = std::max(CPUGramSchmidt::block_size, size_t(1));
+	bool const   cgs2       = this->algorithm == CPUGramSchmidt::Algorithm::cgs2;
+	for (size_t block_begin = 0; block_begin < vector_count; block_begin += block_size)
+	{
+		size_t const block_end = std::min(block_begin + block_size, vector_count);
+		double *const block    = vectors + block_begin * dim;
+
+		// 1. CGS2 only: second pass against all previous blocks
+		if ((cgs2) && (block_begin > 0))
+			this->pool->parallel_for(block_begin, block_end, (min_task_work + block_begin * dim - 1) / (block_begin * dim), [&](size_t const first_vec_i, size_t const last_vec_i)
+			{
+				for (size_t vec_i = first_vec_i; vec_i < last_vec_i; ++vec_i)
+					project_out_classical(vectors, block_begin, vectors + vec_i * dim, dim);
+			});
+
+		// 2. Orthonormalise vectors of the block among themselves
+		for (size_t vec_i = block_begin; vec_i < block_end; ++vec_i)
+		{
+			double *const vector = vectors + vec_i * dim;
+			if (cgs2)
+			{
+				project_out_classical(block, vec_i - block_begin, vector, dim);
+				project_out_classical(block, vec_i - block_begin, vector, dim);
+			}
+			else
+				project_out_sequential(block, vec_i - block_begin, vector, dim);
+			vgs::scale(1.0 / std::sqrt(vgs::dot(vector, vector, dim)), vector, dim);
+		}
+
+		// 3. Remove the components along the block from all the remaining vectors
+		this->project_out(block, block_end - block_begin, vectors + block_end * dim, vector_count - block_end, dim);
+	}
+	return;
+}
+
+
+
+
+
+void CPUGramSchmidt::project_out(double const *const basis, size_t const basis_count, double *const vectors, size_t const vector_count, size_t const dim)
+{
+	// Every task gets at least min_task_work multiply-adds, so the projections of small matrices
+	// are done by the thread that owns the matrix
+	size_t const vector_work = std::max(basis_count * dim, size_t(1));
+	size_t const grain       = std::max({vector_count / (4 * this->pool->size()), (min_task_work + vector_work - 1) / vector_work, size_t(1)});
+	this->pool->parallel_for(0, vector_count, grain, [&](size_t const first_vec_i, size_t const last_vec_i)
+	{
+		for (size_t vec_i = first_vec_i; vec_i < last_vec_i; ++vec_i)
+			if (this->algorithm == CPUGramSchmidt::Algorithm::cgs2)
+				project_out_classical(basis, basis_count, vectors + vec_i * dim, dim);
+			else
+				project_out_sequential(basis, basis_count, vectors + vec_i * dim, dim);
+	});
+	return;
+}
+
+
+
+
+
+uint32_t CPUGramSchmidt::thread_count(void) const
+{
+	return this->pool->size();
+}
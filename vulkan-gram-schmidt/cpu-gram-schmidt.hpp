@@ -0,0 +1,173 @@
+/**
+ * @file cpu-gram-schmidt.hpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#ifndef __VGS_CPU_HPP__
+#define __VGS_CPU_HPP__
+
+
+
+
+
+#include "thread-pool.hpp"
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+
+
+
+
+/**
+ * @class CPUGramSchmidt
+ * @brief Tools to execute Gram-Schmidt process on CPU.
+ *
+ * This class provides the same interface as GPUGramSchmidt, but does all the work on the host
+ * with a pool of threads. It is used by GPUGramSchmidt on machines without a suitable GPU and
+ * may be used on its own as well. Solvers with the same number of threads share one pool.
+ * 
+ * Vectors are processed in blocks: vectors of a block are orthonormalised among themselves by
+ * one thread, after which all the remaining vectors are cleared of the components along the block
+ * in parallel.
+ * 
+ * Matrices of orders 2 to 16 are processed by the fixed-size kernels of fixed-gram-schmidt.hpp.
+ * 
+ * Batches of matrices are processed with one task per matrix; tasks are balanced between the
+ * threads by work stealing, and the panels of large matrices become tasks of their own.
+ * 
+ * Matrices passed to the CPUGramSchmidt::run function are required to be non-singular; otherwise,
+ * no guarantees are given about the behaviour of the program.
+ */
+class CPUGramSchmidt final
+{
+
+
+
+public:
+
+	using Matrix = std::vector<std::vector<double>>;
+
+	/**
+	 * @brief Orthogonalisation scheme
+	 */
+	enum class Algorithm : uint8_t
+	{
+		mgs,  ///< Modified Gram-Schmidt: projections are subtracted one by one
+		cgs2  ///< Classical Gram-Schmidt with reorthogonalisation: projections onto a whole block are computed at once, twice
+	};
+
+
+
+private:
+
+	std::shared_ptr<vgs::ThreadPool> pool; // shared by all the solvers with the same number of threads
+	Algorithm                        algorithm;
+
+
+
+public:
+
+	/// @name Static parameters
+	/// @{
+
+	/**
+	 * Number of vectors in one block
+	 */
+	static size_t block_size;
+
+	/// @}
+
+	/// @name Constructors & destructors
+	/// @{
+
+	/**
+	 * @brief Creates a new solver
+	 *
+	 * @param thread_count Number of threads to use. 0 means as many as there are hardware threads.
+	 *                     The threads are shared with the other solvers of the same size.
+	 * @param algorithm Orthogonalisation scheme.
+	 */
+	explicit CPUGramSchmidt(uint32_t const thread_count = 0, Algorithm const algorithm = Algorithm::mgs);
+
+	/// @}
+
+
+
+	/// @name Computations
+	/// @{
+
+	/**
+	 * @brief Run Gram-Schmidt process on CPU
+	 *
+	 * Perform orthonormalisation of vectors with the help of CPU.
+	 * 
+	 * @param matrix Square matrix with the coordinates of the original vectors.
+	 * @param vectors_as_columns Indicates whether vectors are packed into @c matrix
+	 *                           as columns or as rows.
+	 * 
+	 * @warning Keep in mind, that the non-singularity of @c matrix must be guaranteed
+	 * by you.
+	 * 
+	 * @return Nothing; the answer is written directly into @c matrix. If `vectors_as_columns == true`,
+	 * the answer will also be written in columns.
+	 */
+	void run(CPUGramSchmidt::Matrix &matrix, bool const vectors_as_columns=false);
+
+	/**
+	 * @brief Run Gram-Schmidt process on CPU for a batch of matrices
+	 *
+	 * Matrices may be of different sizes. Each one is a separate task: its vectors are packed
+	 * into a buffer allocated by the thread that executes the task, so that the memory is local
+	 * to that thread. Large matrices are additionally split into per-panel tasks, which keeps all
+	 * threads busy even when a few big matrices are left at the end of the batch.
+	 * 
+	 * @param matrices Square matrices with the coordinates of the original vectors.
+	 * @param vectors_as_columns Indicates whether vectors are packed into @c matrices
+	 *                           as columns or as rows.
+	 * 
+	 * @warning Keep in mind, that the non-singularity of all @c matrices must be guaranteed
+	 * by you.
+	 * 
+	 * @return Nothing; the answers are written directly into @c matrices.
+	 */
+	void run_batch(std::vector<CPUGramSchmidt::Matrix> &matrices, bool const vectors_as_columns=false);
+
+	/**
+	 * @brief Run Gram-Schmidt process on packed vectors
+	 *
+	 * @param vectors Coordinates of the vectors, one vector after another.
+	 * @param vector_count Number of vectors.
+	 * @param dim Number of coordinates of each vector.
+	 */
+	void orthonormalise(double *const vectors, size_t const vector_count, size_t const dim);
+
+	/**
+	 * @brief Remove the components along orthonormal vectors from packed vectors
+	 *
+	 * The vectors are distributed among the threads. With `Algorithm::mgs` the components
+	 * are subtracted one by one, with `Algorithm::cgs2` all at once (a single pass).
+	 * 
+	 * @param basis Coordinates of the orthonormal vectors, one vector after another.
+	 * @param basis_count Number of the orthonormal vectors.
+	 * @param vectors Coordinates of the vectors to clean, one vector after another.
+	 * @param vector_count Number of the vectors to clean.
+	 * @param dim Number of coordinates of each vector.
+	 */
+	void project_out(double const *const basis, size_t const basis_count, double *const vectors, size_t const vector_count, size_t const dim);
+
+	/**
+	 * @brief Number of threads used by the solver
+	 */
+	uint32_t thread_count(void) const;
+
+	/// @}
+
+
+
+};
+
+
+
+
+
+#endif // __VGS_CPU_HPP__
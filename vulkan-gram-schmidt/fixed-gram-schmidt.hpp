@@ -0,0 +1,159 @@
+/**
+ * @file fixed-gram-schmidt.hpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#ifndef __VGS_FIXED_HPP__
+#define __VGS_FIXED_HPP__
+
+
+
+
+
+#include <array>
+#include <utility>
+#include <cmath>
+#include <cstddef>
+
+
+
+
+
+namespace vgs
+{
+
+
+
+/// @name Fixed-size kernels
+/// @{
+
+/**
+ * Smallest order handled by the fixed-size kernels
+ */
+constexpr size_t min_fixed_dim = 2;
+
+/**
+ * Largest order handled by the fixed-size kernels
+ */
+constexpr size_t max_fixed_dim = 16;
+
+
+
+/**
+ * @brief Dot product of two vectors of @c sizeof...(I) coordinates, unrolled at compile time
+ */
+template <size_t... I>
+inline double fixed_dot(double const *const x, double const *const y, std::index_sequence<I...>)
+{
+	return ((x[I] * y[I]) + ...);
+}
+
+
+
+/**
+ * @brief \f$y \leftarrow y + a x\f$ for vectors of @c sizeof...(I) coordinates, unrolled at compile time
+ */
+template <size_t... I>
+inline void fixed_axpy(double const a, double const *const x, double *const y, std::index_sequence<I...>)
+{
+	((y[I] += a * x[I]), ...);
+	return;
+}
+
+
+
+/**
+ * @brief Run Gram-Schmidt process on a tiny matrix whose order is known at compile time
+ *
+ * All loops have constant trip counts, and the inner ones are unrolled explicitly, so the
+ * whole matrix is kept in registers (or, for the larger orders, in L1 cache) and no memory
+ * is allocated. The result is the same as the one of CPUGramSchmidt.
+ *
+ * @tparam N Order of the matrix.
+ * @param vectors Coordinates of @c N vectors of @c N coordinates each, one vector after another.
+ *
+ * @warning Keep in mind, that the non-singularity of the matrix must be guaranteed by you.
+ */
+template <size_t N>
+inline void orthonormalise_fixed(double *const vectors)
+{
+	constexpr auto coordinates = std::make_index_sequence<N>();
+	double local[N * N];
+	for (size_t i = 0; i < N * N; ++i)
+		local[i] = vectors[i];
+	for (size_t vec_i = 0; vec_i < N; ++vec_i)
+	{
+		double *const vector = local + vec_i * N;
+		for (size_t basis_i = 0; basis_i < vec_i; ++basis_i)
+			fixed_axpy(-fixed_dot(local + basis_i * N, vector, coordinates), local + basis_i * N, vector, coordinates);
+		double const inverse_norm = 1.0 / std::sqrt(fixed_dot(vector, vector, coordinates));
+		for (size_t dim_i = 0; dim_i < N; ++dim_i)
+			vector[dim_i] *= inverse_norm;
+	}
+	for (size_t i = 0; i < N * N; ++i)
+		vectors[i] = local[i];
+	return;
+}
+
+
+
+/**
+ * @brief Run Gram-Schmidt process on a tiny matrix stored as an array of vectors
+ *
+ * @tparam N Order of the matrix.
+ * @param vectors The vectors, one per element of the outer array.
+ */
+template <size_t N>
+inline void orthonormalise_fixed(std::array<std::array<double, N>, N> &vectors)
+{
+	static_assert(sizeof(vectors) == N * N * sizeof(double), "std::array is expected to have no padding");
+	orthonormalise_fixed<N>(vectors[0].data());
+	return;
+}
+
+
+
+/**
+ * @brief Run Gram-Schmidt process on a tiny matrix whose order is known at runtime only
+ *
+ * Dispatches to the fixed-size kernel of the right order.
+ *
+ * @param vectors Coordinates of @c dim vectors of @c dim coordinates each, one vector after another.
+ * @param dim Order of the matrix.
+ *
+ * @return @c false (and does nothing) if @c dim is outside of
+ * \f$[\mathrm{min\_fixed\_dim}, \mathrm{max\_fixed\_dim}]\f$.
+ */
+inline bool orthonormalise_fixed(double *const vectors, size_t const dim)
+{
+	switch (dim)
+	{
+		case 2:  orthonormalise_fixed<2>(vectors);  return true;
+		case 3:  orthonormalise_fixed<3>(vectors);  return true;
+		case 4:  orthonormalise_fixed<4>(vectors);  return true;
+		case 5:  orthonormalise_fixed<5>(vectors);  return true;
+		case 6:  orthonormalise_fixed<6>(vectors);  return true;
+		case 7:  orthonormalise_fixed<7>(vectors);  return true;
+		case 8:  orthonormalise_fixed<8>(vectors);  return true;
+		case 9:  orthonormalise_fixed<9>(vectors);  return true;
+		case 10: orthonormalise_fixed<10>(vectors); return true;
+		case 11: orthonormalise_fixed<11>(vectors); return true;
+		case 12: orthonormalise_fixed<12>(vectors); return true;
+		case 13: orthonormalise_fixed<13>(vectors); return true;
+		case 14: orthonormalise_fixed<14>(vectors); return true;
+		case 15: orthonormalise_fixed<15>(vectors); return true;
+		case 16: orthonormalise_fixed<16>(vectors); return true;
+		default: return false;
+	}
+}
+
+/// @}
+
+
+
+} // namespace vgs
+
+
+
+
+
+#endif // __VGS_FIXED_HPP__
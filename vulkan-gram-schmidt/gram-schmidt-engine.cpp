@@ -0,0 +1,306 @@
+/**
+ * @file gram-schmidt-engine.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "gram-schmidt-engine.hpp"
+#include "vulkan-gram-schmidt.hpp"
+#include "host-kernels.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+
+
+
+
+// Engines
+// Each engine is a thin adapter that owns one of the solvers.
+
+
+
+
+
+/**
+ * @brief GPUGramSchmidt behind the engine interface
+ */
+class VulkanEngine final : public GramSchmidtEngine
+{
+
+
+
+private:
+
+	GPUGramSchmidt solver;
+
+
+
+protected:
+
+	void orthonormalise(Matrix &matrix, bool const vectors_as_columns) override
+	{
+		this->solver.run(matrix, vectors_as_columns);
+		return;
+	}
+
+	void orthonormalise_batch(std::vector<Matrix> &matrices, bool const vectors_as_columns) override
+	{
+		this->solver.run_batch(matrices, vectors_as_columns);
+		return;
+	}
+
+
+
+public:
+
+	explicit VulkanEngine(GPUGramSchmidt::Backend const backend) :
+		solver(false, false, backend)
+	{}
+
+	Capabilities capabilities(void) const override
+	{
+		Capabilities capabilities;
+		bool const   gpu_ready = this->solver.get_backend() != GPUGramSchmidt::Backend::cpu;
+		capabilities.name         = gpu_ready ? ("vulkan (" + this->solver.get_device_name() + ")") : ("vulkan (no GPU, cpu fallback)");
+		capabilities.uses_gpu     = gpu_ready;
+		capabilities.native_batch = true;
+		capabilities.host_threads = std::max(1U, std::thread::hardware_concurrency());
+		return capabilities;
+	}
+
+
+
+};
+
+
+
+
+
+/**
+ * @brief CPUGramSchmidt behind the engine interface
+ */
+class CPUEngine final : public GramSchmidtEngine
+{
+
+
+
+private:
+
+	CPUGramSchmidt solver;
+
+
+
+protected:
+
+	void orthonormalise(Matrix &matrix, bool const vectors_as_columns) override
+	{
+		this->solver.run(matrix, vectors_as_columns);
+		return;
+	}
+
+	void orthonormalise_batch(std::vector<Matrix> &matrices, bool const vectors_as_columns) override
+	{
+		this->solver.run_batch(matrices, vectors_as_columns);
+		return;
+	}
+
+
+
+public:
+
+	Capabilities capabilities(void) const override
+	{
+		static char const *const isa_names[] = {"generic", "avx2", "avx512"};
+		Capabilities capabilities;
+		capabilities.name         = std::string("cpu (") + isa_names[static_cast<uint8_t>(vgs::host_isa())] + ")";
+		capabilities.uses_gpu     = false;
+		capabilities.native_batch = true;
+		capabilities.host_threads = this->solver.thread_count();
+		return capabilities;
+	}
+
+
+
+};
+
+
+
+
+
+#ifdef VGS_WITH_LAPACK
+
+/**
+ * @brief LAPACKGramSchmidt behind the engine interface
+ */
+class LAPACKEngine final : public GramSchmidtEngine
+{
+
+
+
+private:
+
+	LAPACKGramSchmidt solver;
+
+
+
+protected:
+
+	void orthonormalise(Matrix &matrix, bool const vectors_as_columns) override
+	{
+		this->solver.run(matrix, vectors_as_columns);
+		return;
+	}
+
+
+
+public:
+
+	Capabilities capabilities(void) const override
+	{
+		Capabilities capabilities;
+		capabilities.name         = "lapack";
+		capabilities.uses_gpu     = false;
+		capabilities.native_batch = false;
+		capabilities.host_threads = 1; // LAPACK may use threads of its own, this is not known here
+		return capabilities;
+	}
+
+
+
+};
+
+#endif // VGS_WITH_LAPACK
+
+
+
+
+
+// Constructors & destructors
+
+
+
+
+
+std::unique_ptr<GramSchmidtEngine> GramSchmidtEngine::create(GramSchmidtEngine::Kind const kind)
+{
+	switch (kind)
+	{
+		case GramSchmidtEngine::Kind::automatic:
+			return std::unique_ptr<GramSchmidtEngine>(new VulkanEngine(GPUGramSchmidt::Backend::automatic));
+		case GramSchmidtEngine::Kind::vulkan:
+			return std::unique_ptr<GramSchmidtEngine>(new VulkanEngine(GPUGramSchmidt::Backend::gpu));
+		case GramSchmidtEngine::Kind::hybrid:
+			return std::unique_ptr<GramSchmidtEngine>(new VulkanEngine(GPUGramSchmidt::Backend::hybrid));
+		case GramSchmidtEngine::Kind::cpu:
+			return std::unique_ptr<GramSchmidtEngine>(new CPUEngine());
+		case GramSchmidtEngine::Kind::lapack:
+#ifdef VGS_WITH_LAPACK
+			return std::unique_ptr<GramSchmidtEngine>(new LAPACKEngine());
+#else
+			throw std::runtime_error("LAPACK engine is not available: the library was compiled without VGS_WITH_LAPACK.");
+#endif
+	}
+	throw std::runtime_error("Unknown engine kind.");
+}
+
+
+
+
+
+// Description
+
+
+
+
+
+GramSchmidtEngine::Stats GramSchmidtEngine::get_stats(void) const
+{
+	std::lock_guard<std::mutex> guard(this->stats_lock);
+	return this->stats;
+}
+
+
+
+
+
+void GramSchmidtEngine::reset_stats(void)
+{
+	std::lock_guard<std::mutex> guard(this->stats_lock);
+	this->stats = GramSchmidtEngine::Stats();
+	return;
+}
+
+
+
+
+
+void GramSchmidtEngine::record(uint64_t const matrix_count, double const time)
+{
+	std::lock_guard<std::mutex> guard(this->stats_lock);
+	++this->stats.call_count;
+	this->stats.matrix_count += matrix_count;
+	this->stats.total_time   += time;
+	this->stats.max_time      = std::max(this->stats.max_time, time);
+	return;
+}
+
+
+
+
+
+// Computations
+
+
+
+
+
+void GramSchmidtEngine::orthonormalise_batch(std::vector<GramSchmidtEngine::Matrix> &matrices, bool const vectors_as_columns)
+{
+	for (auto &matrix : matrices)
+		this->orthonormalise(matrix, vectors_as_columns);
+	return;
+}
+
+
+
+
+
+void GramSchmidtEngine::run(GramSchmidtEngine::Matrix &matrix, bool const vectors_as_columns)
+{
+	std::lock_guard<std::mutex> guard(this->execution);
+	auto const start_time = std::chrono::steady_clock::now();
+	this->orthonormalise(matrix, vectors_as_columns);
+	this->record(1, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+	return;
+}
+
+
+
+
+
+void GramSchmidtEngine::run_batch(std::vector<GramSchmidtEngine::Matrix> &matrices, bool const vectors_as_columns)
+{
+	std::lock_guard<std::mutex> guard(this->execution);
+	auto const start_time = std::chrono::steady_clock::now();
+	this->orthonormalise_batch(matrices, vectors_as_columns);
+	this->record(matrices.size(), std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+	return;
+}
+
+
+
+
+
+std::future<void> GramSchmidtEngine::run_async(GramSchmidtEngine::Matrix &matrix, bool const vectors_as_columns)
+{
+	return std::async(std::launch::async, [this, &matrix, vectors_as_columns](void) { this->run(matrix, vectors_as_columns); });
+}
+
+
+
+
+
+std::future<void> GramSchmidtEngine::run_batch_async(std::vector<GramSchmidtEngine::Matrix> &matrices, bool const vectors_as_columns)
+{
+	return std::async(std::launch::async, [this, &matrices, vectors_as_columns](void) { this->run_batch(matrices, vectors_as_columns); });
+}
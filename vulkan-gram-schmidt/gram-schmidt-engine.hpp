@@ -0,0 +1,229 @@
+/**
+ * @file gram-schmidt-engine.hpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#ifndef __VGS_ENGINE_HPP__
+#define __VGS_ENGINE_HPP__
+
+
+
+
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <cstdint>
+
+
+
+
+
+/**
+ * @class GramSchmidtEngine
+ * @brief Common interface of all the solvers.
+ *
+ * Call sites that only need an orthonormal basis may hold a GramSchmidtEngine created by
+ * GramSchmidtEngine::create and stay unaware of the device and the library behind it. Engines
+ * can then be switched (or compared with each other) by changing a single GramSchmidtEngine::Kind.
+ *
+ * Every engine keeps statistics of its calls (see GramSchmidtEngine::get_stats). Calls to one
+ * engine are serialised, whichever thread they come from; GramSchmidtEngine::run_async returns
+ * immediately and leaves the call to a background thread.
+ *
+ * New engines are made by deriving from this class and implementing GramSchmidtEngine::orthonormalise
+ * and GramSchmidtEngine::capabilities (and GramSchmidtEngine::orthonormalise_batch, if the engine
+ * can do batches better than one matrix after another).
+ */
+class GramSchmidtEngine
+{
+
+
+
+public:
+
+	using Matrix = std::vector<std::vector<double>>;
+
+	/**
+	 * @brief Engines available through GramSchmidtEngine::create
+	 */
+	enum class Kind : uint8_t
+	{
+		automatic, ///< GPUGramSchmidt with `Backend::automatic`: GPU or CPU, whichever is faster for the matrix
+		vulkan,    ///< GPUGramSchmidt with `Backend::gpu`: GPU only
+		hybrid,    ///< GPUGramSchmidt with `Backend::hybrid`: GPU and CPU together
+		cpu,       ///< CPUGramSchmidt: all host threads, SIMD kernels
+		lapack     ///< LAPACKGramSchmidt: Householder QR of the installed LAPACK (needs @c VGS_WITH_LAPACK)
+	};
+
+	/**
+	 * @brief What an engine is and what it can do
+	 */
+	struct Capabilities
+	{
+		std::string name;                 ///< Human-readable name, e.g. "cpu (avx512)"
+		bool        uses_gpu     = false; ///< Whether (some) computations are done on GPU right now
+		bool        native_batch = false; ///< Whether GramSchmidtEngine::run_batch is faster than running the matrices one by one
+		uint32_t    host_threads = 1;     ///< Number of host threads used for computations
+	};
+
+	/**
+	 * @brief Statistics of the calls to an engine
+	 */
+	struct Stats
+	{
+		uint64_t call_count   = 0;   ///< Number of calls to GramSchmidtEngine::run and GramSchmidtEngine::run_batch
+		uint64_t matrix_count = 0;   ///< Number of matrices processed
+		double   total_time   = 0.0; ///< Total duration of the calls, seconds
+		double   max_time     = 0.0; ///< Duration of the longest call, seconds
+	};
+
+
+
+private:
+
+	std::mutex         execution;  // calls are serialised
+	mutable std::mutex stats_lock; // protects stats
+	Stats              stats;
+
+	void record(uint64_t const matrix_count, double const time);
+
+
+
+protected:
+
+	/// @name Implementation
+	/// @{
+
+	/**
+	 * @brief Orthonormalise one matrix
+	 *
+	 * Same contract as GramSchmidtEngine::run.
+	 */
+	virtual void orthonormalise(Matrix &matrix, bool const vectors_as_columns) = 0;
+
+	/**
+	 * @brief Orthonormalise a batch of matrices
+	 *
+	 * Same contract as GramSchmidtEngine::run_batch. Processes the matrices one by one unless
+	 * overridden.
+	 */
+	virtual void orthonormalise_batch(std::vector<Matrix> &matrices, bool const vectors_as_columns);
+
+	/// @}
+
+
+
+public:
+
+	/// @name Constructors & destructors
+	/// @{
+
+	GramSchmidtEngine(void) = default;
+
+	virtual ~GramSchmidtEngine(void) = default;
+
+	GramSchmidtEngine(GramSchmidtEngine const &) = delete;
+	GramSchmidtEngine &operator=(GramSchmidtEngine const &) = delete;
+
+	/**
+	 * @brief Create an engine
+	 *
+	 * @param kind Engine to create.
+	 *
+	 * @throw std::runtime_error If the engine is not available on this machine or in this build.
+	 */
+	static std::unique_ptr<GramSchmidtEngine> create(Kind const kind);
+
+	/// @}
+
+
+
+	/// @name Description
+	/// @{
+
+	/**
+	 * @brief Describe the engine
+	 */
+	virtual Capabilities capabilities(void) const = 0;
+
+	/**
+	 * @brief Get the statistics of the calls so far
+	 */
+	Stats get_stats(void) const;
+
+	/**
+	 * @brief Forget the statistics of the calls so far
+	 */
+	void reset_stats(void);
+
+	/// @}
+
+
+
+	/// @name Computations
+	/// @{
+
+	/**
+	 * @brief Run Gram-Schmidt process
+	 *
+	 * @param matrix Square matrix with the coordinates of the original vectors.
+	 * @param vectors_as_columns Indicates whether vectors are packed into @c matrix
+	 *                           as columns or as rows.
+	 *
+	 * @warning Keep in mind, that the non-singularity of @c matrix must be guaranteed
+	 * by you.
+	 *
+	 * @return Nothing; the answer is written directly into @c matrix. If `vectors_as_columns == true`,
+	 * the answer will also be written in columns.
+	 */
+	void run(Matrix &matrix, bool const vectors_as_columns=false);
+
+	/**
+	 * @brief Run Gram-Schmidt process for a batch of matrices
+	 *
+	 * @param matrices Square matrices (possibly of different orders) with the coordinates of the
+	 *                 original vectors.
+	 * @param vectors_as_columns Indicates whether vectors are packed into @c matrices
+	 *                           as columns or as rows.
+	 *
+	 * @warning Keep in mind, that the non-singularity of all @c matrices must be guaranteed
+	 * by you.
+	 */
+	void run_batch(std::vector<Matrix> &matrices, bool const vectors_as_columns=false);
+
+	/**
+	 * @brief Run Gram-Schmidt process in a background thread
+	 *
+	 * Same as GramSchmidtEngine::run, but returns immediately.
+	 *
+	 * @warning @c matrix must stay alive and untouched, and the engine must stay alive, until the
+	 * returned future is ready: the engine does not wait for pending calls when destroyed.
+	 *
+	 * @return Future that becomes ready when the answer is written into @c matrix; it rethrows
+	 * the errors of the computation.
+	 */
+	std::future<void> run_async(Matrix &matrix, bool const vectors_as_columns=false);
+
+	/**
+	 * @brief Run Gram-Schmidt process for a batch of matrices in a background thread
+	 *
+	 * Same as GramSchmidtEngine::run_batch, but returns immediately.
+	 *
+	 * @warning @c matrices must stay alive and untouched, and the engine must stay alive, until
+	 * the returned future is ready: the engine does not wait for pending calls when destroyed.
+	 */
+	std::future<void> run_batch_async(std::vector<Matrix> &matrices, bool const vectors_as_columns=false);
+
+	/// @}
+
+
+
+};
+
+
+
+
+
+#endif // __VGS_ENGINE_HPP__
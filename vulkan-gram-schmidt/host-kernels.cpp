@@ -0,0 +1,281 @@
+/**
+ * @file host-kernels.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "host-kernels.hpp"
+#include <atomic>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	#define VGS_HOST_X86
+	#include <immintrin.h>
+	#define VGS_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+
+
+
+
+// Portable kernels
+// All loops keep several independent accumulators (or independent lanes) so that the compiler
+// is free to vectorise them and consecutive additions do not wait for each other.
+
+
+
+
+
+static double dot_generic(double const *const x, double const *const y, size_t const n)
+{
+	double acc_0 = 0.0, acc_1 = 0.0, acc_2 = 0.0, acc_3 = 0.0;
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		acc_0 += x[i]     * y[i];
+		acc_1 += x[i + 1] * y[i + 1];
+		acc_2 += x[i + 2] * y[i + 2];
+		acc_3 += x[i + 3] * y[i + 3];
+	}
+	for (; i < n; ++i)
+		acc_0 += x[i] * y[i];
+	return (acc_0 + acc_1) + (acc_2 + acc_3);
+}
+
+
+
+
+
+static void axpy_generic(double const a, double const *const x, double *const y, size_t const n)
+{
+	for (size_t i = 0; i < n; ++i)
+		y[i] += a * x[i];
+	return;
+}
+
+
+
+
+
+// x86 kernels
+// Four independent accumulators hide the latency of FMA (4 cycles, 2 ports on recent cores).
+// All loads are unaligned: rows of a packed matrix start at arbitrary multiples of 8 bytes.
+// Tails shorter than one register are handled with masks (AVX-512) or scalar code (AVX2).
+
+
+
+
+
+#ifdef VGS_HOST_X86
+
+VGS_TARGET("avx2,fma")
+static double dot_avx2(double const *const x, double const *const y, size_t const n)
+{
+	__m256d acc_0 = _mm256_setzero_pd(), acc_1 = _mm256_setzero_pd(), acc_2 = _mm256_setzero_pd(), acc_3 = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		acc_0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i),      _mm256_loadu_pd(y + i),      acc_0);
+		acc_1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 4),  _mm256_loadu_pd(y + i + 4),  acc_1);
+		acc_2 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 8),  _mm256_loadu_pd(y + i + 8),  acc_2);
+		acc_3 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 12), _mm256_loadu_pd(y + i + 12), acc_3);
+	}
+	for (; i + 4 <= n; i += 4)
+		acc_0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), acc_0);
+	__m256d const acc     = _mm256_add_pd(_mm256_add_pd(acc_0, acc_1), _mm256_add_pd(acc_2, acc_3));
+	__m128d const acc_128 = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+	double result = _mm_cvtsd_f64(_mm_add_sd(acc_128, _mm_unpackhi_pd(acc_128, acc_128)));
+	for (; i < n; ++i)
+		result += x[i] * y[i];
+	return result;
+}
+
+
+
+
+
+VGS_TARGET("avx2,fma")
+static void axpy_avx2(double const a, double const *const x, double *const y, size_t const n)
+{
+	__m256d const a_4 = _mm256_set1_pd(a);
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		_mm256_storeu_pd(y + i,      _mm256_fmadd_pd(a_4, _mm256_loadu_pd(x + i),      _mm256_loadu_pd(y + i)));
+		_mm256_storeu_pd(y + i + 4,  _mm256_fmadd_pd(a_4, _mm256_loadu_pd(x + i + 4),  _mm256_loadu_pd(y + i + 4)));
+		_mm256_storeu_pd(y + i + 8,  _mm256_fmadd_pd(a_4, _mm256_loadu_pd(x + i + 8),  _mm256_loadu_pd(y + i + 8)));
+		_mm256_storeu_pd(y + i + 12, _mm256_fmadd_pd(a_4, _mm256_loadu_pd(x + i + 12), _mm256_loadu_pd(y + i + 12)));
+	}
+	for (; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(y + i, _mm256_fmadd_pd(a_4, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+	for (; i < n; ++i)
+		y[i] += a * x[i];
+	return;
+}
+
+
+
+
+
+VGS_TARGET("avx512f")
+static double dot_avx512(double const *const x, double const *const y, size_t const n)
+{
+	__m512d acc_0 = _mm512_setzero_pd(), acc_1 = _mm512_setzero_pd(), acc_2 = _mm512_setzero_pd(), acc_3 = _mm512_setzero_pd();
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32)
+	{
+		acc_0 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i),      _mm512_loadu_pd(y + i),      acc_0);
+		acc_1 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i + 8),  _mm512_loadu_pd(y + i + 8),  acc_1);
+		acc_2 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i + 16), _mm512_loadu_pd(y + i + 16), acc_2);
+		acc_3 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i + 24), _mm512_loadu_pd(y + i + 24), acc_3);
+	}
+	for (; i + 8 <= n; i += 8)
+		acc_0 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i), acc_0);
+	if (i < n)
+	{
+		__mmask8 const tail = static_cast<__mmask8>((1U << (n - i)) - 1);
+		acc_1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tail, x + i), _mm512_maskz_loadu_pd(tail, y + i), acc_1);
+	}
+	alignas(64) double lanes[8];
+	_mm512_store_pd(lanes, _mm512_add_pd(_mm512_add_pd(acc_0, acc_1), _mm512_add_pd(acc_2, acc_3)));
+	return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+
+
+
+
+VGS_TARGET("avx512f")
+static void axpy_avx512(double const a, double const *const x, double *const y, size_t const n)
+{
+	__m512d const a_8 = _mm512_set1_pd(a);
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32)
+	{
+		_mm512_storeu_pd(y + i,      _mm512_fmadd_pd(a_8, _mm512_loadu_pd(x + i),      _mm512_loadu_pd(y + i)));
+		_mm512_storeu_pd(y + i + 8,  _mm512_fmadd_pd(a_8, _mm512_loadu_pd(x + i + 8),  _mm512_loadu_pd(y + i + 8)));
+		_mm512_storeu_pd(y + i + 16, _mm512_fmadd_pd(a_8, _mm512_loadu_pd(x + i + 16), _mm512_loadu_pd(y + i + 16)));
+		_mm512_storeu_pd(y + i + 24, _mm512_fmadd_pd(a_8, _mm512_loadu_pd(x + i + 24), _mm512_loadu_pd(y + i + 24)));
+	}
+	for (; i + 8 <= n; i += 8)
+		_mm512_storeu_pd(y + i, _mm512_fmadd_pd(a_8, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+	if (i < n)
+	{
+		__mmask8 const tail = static_cast<__mmask8>((1U << (n - i)) - 1);
+		_mm512_mask_storeu_pd(y + i, tail, _mm512_fmadd_pd(a_8, _mm512_maskz_loadu_pd(tail, x + i), _mm512_maskz_loadu_pd(tail, y + i)));
+	}
+	return;
+}
+
+#endif // VGS_HOST_X86
+
+
+
+
+
+// Instruction set selection
+
+
+
+
+
+static vgs::HostISA detect_host_isa(void)
+{
+#ifdef VGS_HOST_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return vgs::HostISA::avx512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return vgs::HostISA::avx2;
+#endif
+	return vgs::HostISA::generic;
+}
+
+
+
+
+
+static std::atomic<vgs::HostISA> &selected_host_isa(void)
+{
+	static std::atomic<vgs::HostISA> isa(vgs::best_host_isa());
+	return isa;
+}
+
+
+
+
+
+vgs::HostISA vgs::best_host_isa(void)
+{
+	static vgs::HostISA const isa = detect_host_isa();
+	return isa;
+}
+
+
+
+
+
+vgs::HostISA vgs::host_isa(void)
+{
+	return selected_host_isa().load(std::memory_order_relaxed);
+}
+
+
+
+
+
+vgs::HostISA vgs::set_host_isa(vgs::HostISA const isa)
+{
+	vgs::HostISA const supported_isa = (isa <= vgs::best_host_isa()) ? (isa) : (vgs::best_host_isa());
+	selected_host_isa().store(supported_isa, std::memory_order_relaxed);
+	return supported_isa;
+}
+
+
+
+
+
+// Host kernels
+
+
+
+
+
+double vgs::dot(double const *const x, double const *const y, size_t const n)
+{
+#ifdef VGS_HOST_X86
+	switch (vgs::host_isa())
+	{
+		case vgs::HostISA::avx512: return dot_avx512(x, y, n);
+		case vgs::HostISA::avx2:   return dot_avx2(x, y, n);
+		default:                   break;
+	}
+#endif
+	return dot_generic(x, y, n);
+}
+
+
+
+
+
+void vgs::axpy(double const a, double const *const x, double *const y, size_t const n)
+{
+#ifdef VGS_HOST_X86
+	switch (vgs::host_isa())
+	{
+		case vgs::HostISA::avx512: axpy_avx512(a, x, y, n); return;
+		case vgs::HostISA::avx2:   axpy_avx2(a, x, y, n);   return;
+		default:                   break;
+	}
+#endif
+	axpy_generic(a, x, y, n);
+	return;
+}
+
+
+
+
+
+void vgs::scale(double const a, double *const x, size_t const n)
+{
+	for (size_t i = 0; i < n; ++i)
+		x[i] *= a;
+	return;
+}
@@ -0,0 +1,118 @@
+/**
+ * @file host-kernels.hpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#ifndef __VGS_HOST_KERNELS_HPP__
+#define __VGS_HOST_KERNELS_HPP__
+
+
+
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+
+
+
+/**
+ * @namespace vgs
+ * @brief Building blocks shared by the host-side solvers.
+ */
+namespace vgs
+{
+
+
+
+/**
+ * @brief Instruction set used by the host kernels
+ */
+enum class HostISA : uint8_t
+{
+	generic, ///< Portable C++ loops
+	avx2,    ///< AVX2 with FMA, 4 doubles per instruction
+	avx512   ///< AVX-512F, 8 doubles per instruction
+};
+
+
+
+/// @name Instruction set selection
+/// @{
+
+/**
+ * @brief Best instruction set supported by this CPU (and OS)
+ *
+ * Detected with CPUID once, on the first call.
+ */
+HostISA best_host_isa(void);
+
+/**
+ * @brief Instruction set currently used by the host kernels
+ *
+ * Equals vgs::best_host_isa unless changed by vgs::set_host_isa.
+ */
+HostISA host_isa(void);
+
+/**
+ * @brief Force the host kernels to use the given instruction set
+ *
+ * Meant for benchmarking and debugging.
+ * 
+ * @return The instruction set actually selected: @c isa if it is supported, the best supported
+ * one otherwise.
+ */
+HostISA set_host_isa(HostISA const isa);
+
+/// @}
+
+
+
+/// @name Host kernels
+/// @{
+
+/**
+ * @brief Dot product of two vectors
+ *
+ * @param x First vector.
+ * @param y Second vector.
+ * @param n Number of coordinates.
+ * 
+ * @return \f$\sum_{i=0}^{n-1} x_i y_i\f$.
+ */
+double dot(double const *const x, double const *const y, size_t const n);
+
+/**
+ * @brief Scaled vector addition
+ *
+ * Computes \f$y \leftarrow y + a x\f$.
+ * 
+ * @param a Scalar multiplier.
+ * @param x Vector to add.
+ * @param y Vector to update.
+ * @param n Number of coordinates.
+ */
+void axpy(double const a, double const *const x, double *const y, size_t const n);
+
+/**
+ * @brief Vector scaling
+ *
+ * Computes \f$x \leftarrow a x\f$.
+ * 
+ * @param a Scalar multiplier.
+ * @param x Vector to update.
+ * @param n Number of coordinates.
+ */
+void scale(double const a, double *const x, size_t const n);
+
+/// @}
+
+
+
+} // namespace vgs
+
+
+
+
+
+#endif // __VGS_HOST_KERNELS_HPP__
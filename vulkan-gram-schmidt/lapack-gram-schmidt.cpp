@@ -0,0 +1,107 @@
+/**
+ * @file lapack-gram-schmidt.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "lapack-gram-schmidt.hpp"
+
+#ifdef VGS_WITH_LAPACK
+
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+
+
+
+
+// LAPACK routines (Fortran interface)
+extern "C"
+{
+	void dgeqrf_(int const *m, int const *n, double *a, int const *lda, double *tau, double *work, int const *lwork, int *info);
+	void dorgqr_(int const *m, int const *n, int const *k, double *a, int const *lda, double const *tau, double *work, int const *lwork, int *info);
+}
+
+
+
+
+
+// Computations
+
+
+
+
+
+void LAPACKGramSchmidt::run(LAPACKGramSchmidt::Matrix &matrix, bool const vectors_as_columns)
+{
+	size_t const n = matrix.size();
+	if (n == 0)
+		return;
+
+	// 1. Pack the vectors one after another
+	std::vector<double> vectors(n * n);
+	for (size_t i = 0; i < n; ++i)
+		for (size_t j = 0; j < n; ++j)
+			vectors[i * n + j] = vectors_as_columns ? matrix[j][i] : matrix[i][j];
+
+	// 2. Orthonormalise them
+	this->orthonormalise(vectors.data(), n, n);
+
+	// 3. Read the result into the original matrix
+	for (size_t i = 0; i < n; ++i)
+		for (size_t j = 0; j < n; ++j)
+			matrix[vectors_as_columns ? j : i][vectors_as_columns ? i : j] = vectors[i * n + j];
+	
+	return;
+}
+
+
+
+
+
+void LAPACKGramSchmidt::orthonormalise(double *const vectors, size_t const vector_count, size_t const dim)
+{
+	if (vector_count == 0)
+		return;
+	int const m   = static_cast<int>(dim);
+	int const k   = static_cast<int>(vector_count);
+	int       info = 0;
+
+	// 1. Ask LAPACK for the optimal workspace size of both routines
+	int    query_size = -1;
+	double optimal_qr_size = 0.0, optimal_q_size = 0.0;
+	this->tau.resize(vector_count);
+	dgeqrf_(&m, &k, vectors, &m, this->tau.data(), &optimal_qr_size, &query_size, &info);
+	dorgqr_(&m, &k, &k, vectors, &m, this->tau.data(), &optimal_q_size, &query_size, &info);
+	this->work.resize(std::max(static_cast<size_t>(std::max(optimal_qr_size, optimal_q_size)), size_t(1)));
+	int const work_size = static_cast<int>(this->work.size());
+
+	// 2. Blocked Householder QR decomposition: R is written above the diagonal, the reflectors
+	//    below it
+	dgeqrf_(&m, &k, vectors, &m, this->tau.data(), this->work.data(), &work_size, &info);
+	if (info != 0)
+		throw std::runtime_error("LAPACK routine dgeqrf has failed with info " + std::to_string(info) + ".");
+
+	// 3. Remember the signs of the diagonal of R: Gram-Schmidt process yields positive ones
+	std::vector<bool> flip(vector_count);
+	for (size_t vec_i = 0; vec_i < vector_count; ++vec_i)
+		flip[vec_i] = vectors[vec_i * dim + vec_i] < 0.0;
+
+	// 4. Accumulate the reflectors into Q
+	dorgqr_(&m, &k, &k, vectors, &m, this->tau.data(), this->work.data(), &work_size, &info);
+	if (info != 0)
+		throw std::runtime_error("LAPACK routine dorgqr has failed with info " + std::to_string(info) + ".");
+
+	// 5. Fix the signs
+	for (size_t vec_i = 0; vec_i < vector_count; ++vec_i)
+		if (flip[vec_i])
+			for (size_t dim_i = 0; dim_i < dim; ++dim_i)
+				vectors[vec_i * dim + dim_i] = -vectors[vec_i * dim + dim_i];
+	
+	return;
+}
+
+
+
+
+
+#endif // VGS_WITH_LAPACK
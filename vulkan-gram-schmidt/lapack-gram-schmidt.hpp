@@ -0,0 +1,103 @@
+/**
+ * @file lapack-gram-schmidt.hpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#ifndef __VGS_LAPACK_HPP__
+#define __VGS_LAPACK_HPP__
+
+
+
+
+
+#ifdef VGS_WITH_LAPACK
+
+
+
+
+
+#include <vector>
+#include <cstddef>
+
+
+
+
+
+/**
+ * @class LAPACKGramSchmidt
+ * @brief Tools to find the orthonormal basis with LAPACK.
+ *
+ * This class provides the same interface as GPUGramSchmidt, but computes the answer on the host
+ * with the blocked Householder QR decomposition of an installed LAPACK (OpenBLAS, MKL, BLIS/libFLAME,
+ * reference LAPACK, ...): @c dgeqrf followed by @c dorgqr. Signs are fixed so that the result
+ * coincides with the one of Gram-Schmidt process (the triangular factor has positive diagonal).
+ * 
+ * Available only if the code is compiled with @c VGS_WITH_LAPACK defined and linked with
+ * a LAPACK library that exports the Fortran symbols @c dgeqrf_ and @c dorgqr_ with 32-bit integers.
+ */
+class LAPACKGramSchmidt final
+{
+
+
+
+public:
+
+	using Matrix = std::vector<std::vector<double>>;
+
+
+
+private:
+
+	std::vector<double> tau;
+	std::vector<double> work;
+
+
+
+public:
+
+	/// @name Computations
+	/// @{
+
+	/**
+	 * @brief Find the orthonormal basis with LAPACK
+	 *
+	 * @param matrix Square matrix with the coordinates of the original vectors.
+	 * @param vectors_as_columns Indicates whether vectors are packed into @c matrix
+	 *                           as columns or as rows.
+	 * 
+	 * @warning Keep in mind, that the non-singularity of @c matrix must be guaranteed
+	 * by you.
+	 * 
+	 * @throw std::runtime_error If LAPACK reports an error.
+	 * 
+	 * @return Nothing; the answer is written directly into @c matrix. If `vectors_as_columns == true`,
+	 * the answer will also be written in columns.
+	 */
+	void run(LAPACKGramSchmidt::Matrix &matrix, bool const vectors_as_columns=false);
+
+	/**
+	 * @brief Find the orthonormal basis for packed vectors
+	 *
+	 * @param vectors Coordinates of the vectors, one vector after another (i.e., a column-major
+	 *                @c dim x @c vector_count matrix).
+	 * @param vector_count Number of vectors.
+	 * @param dim Number of coordinates of each vector.
+	 */
+	void orthonormalise(double *const vectors, size_t const vector_count, size_t const dim);
+
+	/// @}
+
+
+
+};
+
+
+
+
+
+#endif // VGS_WITH_LAPACK
+
+
+
+
+
+#endif // __VGS_LAPACK_HPP__
@@ -0,0 +1,251 @@
+/**
+ * @file metrics.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "metrics.hpp"
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+
+
+
+
+
+// Storage
+// Plain relaxed atomics: every metric is exact on its own, and nothing orders them against each
+// other. Durations are kept in nanoseconds.
+
+
+
+
+
+static std::atomic<uint64_t> calls(0);
+static std::atomic<uint64_t> gpu_jobs(0);
+static std::atomic<uint64_t> cpu_jobs(0);
+static std::atomic<uint64_t> hybrid_jobs(0);
+static std::atomic<uint64_t> bytes_uploaded(0);
+static std::atomic<uint64_t> bytes_downloaded(0);
+static std::atomic<uint64_t> gpu_busy_ns(0);
+static std::atomic<int64_t>  queue_depth(0);
+static std::atomic<uint64_t> allocations(0);
+static std::atomic<uint64_t> cpu_fallbacks(0);
+static std::atomic<uint64_t> step_timeouts(0);
+static std::atomic<uint64_t> call_duration_buckets[vgs::call_duration_bucket_count];
+static std::atomic<uint64_t> call_duration_ns(0);
+
+
+
+static uint64_t to_ns(double const seconds)
+{
+	return static_cast<uint64_t>(seconds * 1.0e9 + 0.5);
+}
+
+
+
+
+
+// Recording
+
+
+
+
+
+void vgs::metrics_add_jobs(vgs::MetricsDevice const device, uint64_t const count)
+{
+	switch (device)
+	{
+		case vgs::MetricsDevice::gpu:    gpu_jobs.fetch_add(count, std::memory_order_relaxed);    break;
+		case vgs::MetricsDevice::cpu:    cpu_jobs.fetch_add(count, std::memory_order_relaxed);    break;
+		case vgs::MetricsDevice::hybrid: hybrid_jobs.fetch_add(count, std::memory_order_relaxed); break;
+	}
+	return;
+}
+
+
+
+
+
+void vgs::metrics_add_transfers(uint64_t const uploaded, uint64_t const downloaded)
+{
+	bytes_uploaded.fetch_add(uploaded, std::memory_order_relaxed);
+	bytes_downloaded.fetch_add(downloaded, std::memory_order_relaxed);
+	return;
+}
+
+
+
+
+
+void vgs::metrics_add_gpu_busy_time(double const seconds)
+{
+	gpu_busy_ns.fetch_add(to_ns(seconds), std::memory_order_relaxed);
+	return;
+}
+
+
+
+
+
+void vgs::metrics_add_allocation(void)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	return;
+}
+
+
+
+
+
+void vgs::metrics_add_cpu_fallback(void)
+{
+	cpu_fallbacks.fetch_add(1, std::memory_order_relaxed);
+	return;
+}
+
+
+
+
+
+void vgs::metrics_add_step_timeout(void)
+{
+	step_timeouts.fetch_add(1, std::memory_order_relaxed);
+	return;
+}
+
+
+
+
+
+vgs::CallMetrics::CallMetrics(void) :
+	start_time(std::chrono::steady_clock::now())
+{
+	queue_depth.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+
+
+
+vgs::CallMetrics::~CallMetrics(void)
+{
+	double const duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->start_time).count();
+	size_t bucket_i = 0;
+	while ((bucket_i + 1 < vgs::call_duration_bucket_count) && (duration > vgs::call_duration_bounds[bucket_i]))
+		++bucket_i;
+	call_duration_buckets[bucket_i].fetch_add(1, std::memory_order_relaxed);
+	call_duration_ns.fetch_add(to_ns(duration), std::memory_order_relaxed);
+	calls.fetch_add(1, std::memory_order_relaxed);
+	queue_depth.fetch_sub(1, std::memory_order_relaxed);
+}
+
+
+
+
+
+// Export
+
+
+
+
+
+vgs::MetricsSnapshot vgs::metrics_snapshot(void)
+{
+	vgs::MetricsSnapshot snapshot;
+	snapshot.calls            = calls.load(std::memory_order_relaxed);
+	snapshot.gpu_jobs         = gpu_jobs.load(std::memory_order_relaxed);
+	snapshot.cpu_jobs         = cpu_jobs.load(std::memory_order_relaxed);
+	snapshot.hybrid_jobs      = hybrid_jobs.load(std::memory_order_relaxed);
+	snapshot.bytes_uploaded   = bytes_uploaded.load(std::memory_order_relaxed);
+	snapshot.bytes_downloaded = bytes_downloaded.load(std::memory_order_relaxed);
+	snapshot.gpu_busy_time    = gpu_busy_ns.load(std::memory_order_relaxed) * 1.0e-9;
+	snapshot.queue_depth      = queue_depth.load(std::memory_order_relaxed);
+	snapshot.allocations      = allocations.load(std::memory_order_relaxed);
+	snapshot.cpu_fallbacks    = cpu_fallbacks.load(std::memory_order_relaxed);
+	snapshot.step_timeouts    = step_timeouts.load(std::memory_order_relaxed);
+	for (size_t bucket_i = 0; bucket_i < vgs::call_duration_bucket_count; ++bucket_i)
+		snapshot.call_duration_buckets[bucket_i] = call_duration_buckets[bucket_i].load(std::memory_order_relaxed);
+	snapshot.call_duration_sum = call_duration_ns.load(std::memory_order_relaxed) * 1.0e-9;
+	return snapshot;
+}
+
+
+
+
+
+std::string vgs::render_prometheus(vgs::MetricsSnapshot const &snapshot)
+{
+	std::ostringstream text;
+	char               number[32];
+	auto const header = [&text](char const *const name, char const *const type, char const *const help)
+	{
+		text << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+	};
+
+	// 1. Counters and the gauge
+	header("vgs_calls_total", "counter", "Calls to run and run_batch that have finished.");
+	text << "vgs_calls_total " << snapshot.calls << '\n';
+	header("vgs_jobs_total", "counter", "Matrices processed, by device.");
+	text << "vgs_jobs_total{device=\"gpu\"} " << snapshot.gpu_jobs << '\n'
+	     << "vgs_jobs_total{device=\"cpu\"} " << snapshot.cpu_jobs << '\n'
+	     << "vgs_jobs_total{device=\"hybrid\"} " << snapshot.hybrid_jobs << '\n';
+	header("vgs_transferred_bytes_total", "counter", "Bytes copied between the host and the device memory.");
+	text << "vgs_transferred_bytes_total{direction=\"upload\"} " << snapshot.bytes_uploaded << '\n'
+	     << "vgs_transferred_bytes_total{direction=\"download\"} " << snapshot.bytes_downloaded << '\n';
+	header("vgs_gpu_busy_seconds_total", "counter", "Time the GPU spent executing dispatches (GPU timestamps if enabled, otherwise fence waits).");
+	std::snprintf(number, sizeof(number), "%.9f", snapshot.gpu_busy_time);
+	text << "vgs_gpu_busy_seconds_total " << number << '\n';
+	header("vgs_queue_depth", "gauge", "Calls in progress.");
+	text << "vgs_queue_depth " << snapshot.queue_depth << '\n';
+	header("vgs_allocations_total", "counter", "Vulkan memory allocations.");
+	text << "vgs_allocations_total " << snapshot.allocations << '\n';
+	header("vgs_cpu_fallbacks_total", "counter", "Calls sent to the CPU because the GPU was not set up.");
+	text << "vgs_cpu_fallbacks_total " << snapshot.cpu_fallbacks << '\n';
+	header("vgs_step_timeouts_total", "counter", "GPU steps that exceeded the step timeout; each disables the GPU of its solver.");
+	text << "vgs_step_timeouts_total " << snapshot.step_timeouts << '\n';
+
+	// 2. The histogram; Prometheus buckets are cumulative
+	header("vgs_call_duration_seconds", "histogram", "Duration of the calls to run and run_batch.");
+	uint64_t cumulative = 0;
+	for (size_t bucket_i = 0; bucket_i < vgs::call_duration_bucket_count; ++bucket_i)
+	{
+		cumulative += snapshot.call_duration_buckets[bucket_i];
+		if (bucket_i + 1 < vgs::call_duration_bucket_count)
+			std::snprintf(number, sizeof(number), "%g", vgs::call_duration_bounds[bucket_i]);
+		else
+			std::snprintf(number, sizeof(number), "+Inf");
+		text << "vgs_call_duration_seconds_bucket{le=\"" << number << "\"} " << cumulative << '\n';
+	}
+	std::snprintf(number, sizeof(number), "%.9f", snapshot.call_duration_sum);
+	text << "vgs_call_duration_seconds_sum " << number << '\n'
+	     << "vgs_call_duration_seconds_count " << cumulative << '\n';
+	return text.str();
+}
+
+
+
+
+
+std::string vgs::render_prometheus(void)
+{
+	return vgs::render_prometheus(vgs::metrics_snapshot());
+}
+
+
+
+
+
+void vgs::write_metrics(std::string const &path)
+{
+	std::string const temporary_path = path + ".tmp";
+	{
+		std::ofstream file(temporary_path);
+		file << vgs::render_prometheus();
+		if (file.fail())
+			throw std::runtime_error("File '" + temporary_path + "' cannot be written.");
+	}
+	if (std::rename(temporary_path.c_str(), path.c_str()) != 0)
+		throw std::runtime_error("File '" + path + "' cannot be written.");
+	return;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file metrics.hpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#ifndef __VGS_METRICS_HPP__
+#define __VGS_METRICS_HPP__
+
+
+
+
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+
+
+
+
+namespace vgs
+{
+
+
+
+/**
+ * Upper bounds of the buckets of the call duration histogram, seconds; the last bucket (+Inf)
+ * is implicit
+ */
+constexpr double call_duration_bounds[] = {1.0e-5, 1.0e-4, 1.0e-3, 1.0e-2, 1.0e-1, 1.0, 10.0};
+
+/// Number of buckets of the call duration histogram, +Inf included
+constexpr size_t call_duration_bucket_count = sizeof(call_duration_bounds) / sizeof(double) + 1;
+
+/**
+ * @brief Device that processed a matrix
+ */
+enum class MetricsDevice : uint8_t
+{
+	gpu,
+	cpu,
+	hybrid ///< split between GPU and CPU
+};
+
+/**
+ * @brief Values of all the metrics at one moment
+ *
+ * Metrics are kept for the whole process, summed over all the solvers. Every value is exact, but
+ * values read while calls are in progress may be slightly out of step with one another.
+ */
+struct MetricsSnapshot
+{
+	uint64_t calls            = 0;   ///< Calls to GPUGramSchmidt::run and GPUGramSchmidt::run_batch that have finished
+	uint64_t gpu_jobs         = 0;   ///< Matrices processed on GPU
+	uint64_t cpu_jobs         = 0;   ///< Matrices processed on CPU
+	uint64_t hybrid_jobs      = 0;   ///< Matrices split between GPU and CPU
+	uint64_t bytes_uploaded   = 0;   ///< Bytes written into the device memory
+	uint64_t bytes_downloaded = 0;   ///< Bytes read from the device memory
+	double   gpu_busy_time    = 0.0; ///< Time the GPU spent on dispatches, seconds (see vgs::metrics_add_gpu_busy_time)
+	int64_t  queue_depth      = 0;   ///< Calls in progress right now
+	uint64_t allocations      = 0;   ///< Vulkan memory allocations
+	uint64_t cpu_fallbacks    = 0;   ///< Calls sent to the CPU because the GPU was not (yet) set up
+	uint64_t step_timeouts    = 0;   ///< GPU steps that exceeded GPUGramSchmidt::step_timeout
+
+	uint64_t call_duration_buckets[call_duration_bucket_count] = {}; ///< Calls per bucket of duration (not cumulative)
+	double   call_duration_sum                                 = 0.0; ///< Total duration of the calls, seconds
+};
+
+
+
+/// @name Recording
+/// The solvers record everything themselves; all of these are lock-free.
+/// @{
+
+/**
+ * @brief Count matrices processed by a device
+ *
+ * @param device Device that processed them.
+ * @param count Number of matrices.
+ */
+void metrics_add_jobs(MetricsDevice const device, uint64_t const count);
+
+/**
+ * @brief Count bytes copied between the host and the device memory
+ *
+ * @param bytes_uploaded Bytes written into the device memory.
+ * @param bytes_downloaded Bytes read from the device memory.
+ */
+void metrics_add_transfers(uint64_t const bytes_uploaded, uint64_t const bytes_downloaded);
+
+/**
+ * @brief Add time the GPU spent executing a step
+ *
+ * Measured with GPU timestamps when the step is timed; otherwise, the host's wait for the fence
+ * of the step is used. Host-side packing, submission and the CPU share of the hybrid mode are
+ * not included.
+ *
+ * @param seconds Duration of the step.
+ */
+void metrics_add_gpu_busy_time(double const seconds);
+
+/**
+ * @brief Count one allocation of Vulkan device memory
+ */
+void metrics_add_allocation(void);
+
+/**
+ * @brief Count one call sent to the CPU because the GPU was not (yet) set up
+ */
+void metrics_add_cpu_fallback(void);
+
+/**
+ * @brief Count one GPU step that exceeded GPUGramSchmidt::step_timeout
+ *
+ * The solver stops using its GPU after that, so every increment means a lost GPU.
+ */
+void metrics_add_step_timeout(void);
+
+/**
+ * @class CallMetrics
+ * @brief Counts a call as in progress from its construction to its destruction, then adds its
+ * duration to the histogram
+ */
+class CallMetrics final
+{
+	std::chrono::steady_clock::time_point const start_time;
+
+public:
+
+	CallMetrics(void);
+
+	~CallMetrics(void);
+
+	CallMetrics(CallMetrics const &) = delete;
+	CallMetrics &operator=(CallMetrics const &) = delete;
+};
+
+/// @}
+
+
+
+/// @name Export
+/// @{
+
+/**
+ * @brief Reads all the metrics
+ */
+MetricsSnapshot metrics_snapshot(void);
+
+/**
+ * @brief Renders metrics in the Prometheus text exposition format
+ *
+ * Counters are named @c vgs_*_total, the call durations form the histogram
+ * @c vgs_call_duration_seconds. The result can be served by an HTTP handler as it is.
+ *
+ * @param snapshot Metrics to render.
+ */
+std::string render_prometheus(MetricsSnapshot const &snapshot);
+
+/**
+ * @brief Renders the current metrics in the Prometheus text exposition format
+ */
+std::string render_prometheus(void);
+
+/**
+ * @brief Writes the current metrics in the Prometheus text exposition format into a file
+ *
+ * The file is written under a temporary name and then renamed, so a scraper (e.g. the textfile
+ * collector of the node exporter) never reads it half-written.
+ *
+ * @param path File to write.
+ *
+ * @throw std::runtime_error If the file cannot be written.
+ */
+void write_metrics(std::string const &path);
+
+/// @}
+
+
+
+} // namespace vgs
+
+
+
+
+
+#endif // __VGS_METRICS_HPP__
@@ -0,0 +1,140 @@
+/**
+ * @file numa.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "numa.hpp"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+
+#if defined(__linux__)
+	#include <pthread.h>
+	#include <sched.h>
+	#define VGS_HOST_LINUX
+#endif
+
+
+
+
+
+// Helpers
+
+
+
+
+
+/**
+ * @brief Parses a list of indices in the kernel format, e.g. `0-3,8,10-11`
+ *
+ * @param path File to read the list from.
+ *
+ * @return The indices, empty if the file is missing.
+ */
+static std::vector<uint32_t> read_index_list(std::string const &path)
+{
+	std::vector<uint32_t> indices;
+	std::ifstream file(path);
+	std::string   line;
+	if (!std::getline(file, line))
+		return indices;
+	std::stringstream ranges(line);
+	std::string       range;
+	while (std::getline(ranges, range, ','))
+	{
+		unsigned first = 0, last = 0;
+		int const read_count = std::sscanf(range.c_str(), "%u-%u", &first, &last);
+		if (read_count < 1)
+			continue;
+		if (read_count == 1)
+			last = first;
+		for (uint32_t index = first; index <= last; ++index)
+			indices.push_back(index);
+	}
+	return indices;
+}
+
+
+
+
+
+#ifdef VGS_HOST_LINUX
+
+/**
+ * @brief Restricts a thread to the given CPUs
+ */
+static bool set_thread_cpus(pthread_t const thread, std::vector<uint32_t> const &cpus)
+{
+	if (cpus.empty())
+		return false;
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	for (uint32_t const cpu : cpus)
+		if (cpu < CPU_SETSIZE)
+			CPU_SET(cpu, &cpu_set);
+	return pthread_setaffinity_np(thread, sizeof(cpu_set), &cpu_set) == 0;
+}
+
+#endif
+
+
+
+
+
+// Topology
+
+
+
+
+
+std::vector<uint32_t> vgs::numa_nodes(void)
+{
+	std::vector<uint32_t> nodes = read_index_list("/sys/devices/system/node/online");
+	if (nodes.empty())
+		nodes.push_back(0);
+	return nodes;
+}
+
+
+
+
+
+std::vector<uint32_t> vgs::numa_node_cpus(uint32_t const node)
+{
+	return read_index_list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+}
+
+
+
+
+
+int32_t vgs::pci_numa_node(uint32_t const domain, uint32_t const bus, uint32_t const device, uint32_t const function)
+{
+	char address[32];
+	std::snprintf(address, sizeof(address), "%04x:%02x:%02x.%x", domain, bus, device, function);
+	std::ifstream file(std::string("/sys/bus/pci/devices/") + address + "/numa_node");
+	int32_t node = -1;
+	if (!(file >> node))
+		return -1;
+	return node; // the kernel itself reports -1 if the platform does not tell
+}
+
+
+
+
+
+// Thread binding
+
+
+
+
+
+bool vgs::bind_to_numa_node(std::thread &thread, uint32_t const node)
+{
+#ifdef VGS_HOST_LINUX
+	return set_thread_cpus(thread.native_handle(), vgs::numa_node_cpus(node));
+#else
+	return false;
+#endif
+}
+
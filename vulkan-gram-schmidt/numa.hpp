@@ -0,0 +1,86 @@
+/**
+ * @file numa.hpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#ifndef __VGS_NUMA_HPP__
+#define __VGS_NUMA_HPP__
+
+
+
+
+
+#include <vector>
+#include <thread>
+#include <cstdint>
+
+
+
+
+
+namespace vgs
+{
+
+
+
+/// @name Topology
+/// @{
+
+/**
+ * @brief Identifiers of the online NUMA nodes
+ *
+ * Read from `/sys/devices/system/node` on Linux. Machines without NUMA (and other systems)
+ * report a single node 0.
+ */
+std::vector<uint32_t> numa_nodes(void);
+
+/**
+ * @brief Logical CPUs of a NUMA node
+ *
+ * @param node Identifier of the node.
+ *
+ * @return Indices of the CPUs, empty if unknown.
+ */
+std::vector<uint32_t> numa_node_cpus(uint32_t const node);
+
+/**
+ * @brief NUMA node a PCI device is attached to
+ *
+ * @param domain PCI domain of the device.
+ * @param bus PCI bus of the device.
+ * @param device PCI device number.
+ * @param function PCI function number.
+ *
+ * @return Identifier of the node, -1 if unknown.
+ */
+int32_t pci_numa_node(uint32_t const domain, uint32_t const bus, uint32_t const device, uint32_t const function);
+
+/// @}
+
+
+
+/// @name Thread binding
+/// @{
+
+/**
+ * @brief Restrict a thread to the CPUs of a NUMA node
+ *
+ * Memory first touched by the thread is then placed on that node by the OS.
+ *
+ * @param thread Thread to bind.
+ * @param node Identifier of the node.
+ *
+ * @return Whether the thread was bound.
+ */
+bool bind_to_numa_node(std::thread &thread, uint32_t const node);
+
+/// @}
+
+
+
+} // namespace vgs
+
+
+
+
+
+#endif // __VGS_NUMA_HPP__
@@ -0,0 +1,249 @@
+/**
+ * @file thread-pool.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "thread-pool.hpp"
+#include "numa.hpp"
+#include <algorithm>
+
+
+
+
+
+// Identity of the current thread: the pool it works for (if any) and the index of its queue
+static thread_local vgs::ThreadPool const *current_pool    = nullptr;
+static thread_local uint32_t               current_queue_i = 0;
+
+
+
+
+
+// Constructors & destructors
+
+
+
+
+
+vgs::ThreadPool::ThreadPool(uint32_t const thread_count, int32_t const numa_node) :
+	queued(0),
+	stopping(false)
+{
+	uint32_t const total_count = (thread_count > 0) ? (thread_count) : (std::max(1U, std::thread::hardware_concurrency()));
+	for (uint32_t queue_i = 0; queue_i < total_count; ++queue_i)
+		this->queues.emplace_back(new Queue());
+	for (uint32_t worker_i = 1; worker_i < total_count; ++worker_i)
+		this->workers.emplace_back(&ThreadPool::work, this, worker_i);
+	// On NUMA machines, workers are spread evenly over the nodes (or put on the requested one) and
+	// stay there, so that the memory they first touch remains local to them
+	std::vector<uint32_t> const nodes = vgs::numa_nodes();
+	if (nodes.size() > 1)
+		for (uint32_t worker_i = 1; worker_i < total_count; ++worker_i)
+			vgs::bind_to_numa_node(this->workers[worker_i - 1], (numa_node >= 0) ? (numa_node) : (nodes[worker_i * nodes.size() / total_count]));
+}
+
+
+
+
+
+vgs::ThreadPool::~ThreadPool(void)
+{
+	{
+		std::lock_guard<std::mutex> guard(this->sleep);
+		this->stopping = true;
+	}
+	this->wake.notify_all();
+	for (auto &worker : this->workers)
+		worker.join();
+}
+
+
+
+
+
+// Execution
+
+
+
+
+
+uint32_t vgs::ThreadPool::size(void) const
+{
+	return this->workers.size() + 1;
+}
+
+
+
+
+
+void vgs::ThreadPool::parallel_for(size_t const begin, size_t const end, size_t const grain, vgs::ThreadPool::Body const &body)
+{
+	if (end <= begin)
+		return;
+	size_t const safe_grain = std::max(grain, size_t(1));
+	// 1. Loops that fit into a single chunk are not worth waking anyone up
+	if ((this->workers.empty()) || (end - begin <= safe_grain))
+	{
+		body(begin, end);
+		return;
+	}
+
+	// 2. Push all the chunks to the own queue, where idle threads can steal them from, and help
+	//    with them. Chunks of this loop are at the back of the own queue, so they are taken
+	//    first; if the queue runs dry while some chunks are still being processed by others,
+	//    help them with whatever there is to steal.
+	this->run_loop(this->own_queue(), true, begin, end, safe_grain, body);
+	return;
+}
+
+
+
+
+
+void vgs::ThreadPool::parallel_for_on_workers(size_t const begin, size_t const end, size_t const grain, vgs::ThreadPool::Body const &body)
+{
+	if ((this->workers.empty()) || (current_pool == this))
+	{
+		this->parallel_for(begin, end, grain, body);
+		return;
+	}
+
+	// Chunks go to the queue of the threads outside of the pool, the workers steal them from
+	// there while the caller only waits
+	this->run_loop(0, false, begin, end, std::max(grain, size_t(1)), body);
+	return;
+}
+
+
+
+
+
+void vgs::ThreadPool::work(uint32_t const queue_i)
+{
+	current_pool    = this;
+	current_queue_i = queue_i;
+	while (true)
+	{
+		if (this->run_one(queue_i))
+			continue;
+		std::unique_lock<std::mutex> guard(this->sleep);
+		this->wake.wait(guard, [this](void) { return this->stopping || this->queued.load() > 0; });
+		if (this->stopping)
+			return;
+	}
+}
+
+
+
+
+
+uint32_t vgs::ThreadPool::own_queue(void) const
+{
+	return (current_pool == this) ? (current_queue_i) : (0);
+}
+
+
+
+
+
+void vgs::ThreadPool::push(uint32_t const queue_i, vgs::ThreadPool::Task const &task)
+{
+	{
+		std::lock_guard<std::mutex> guard(this->queues[queue_i]->lock);
+		this->queues[queue_i]->tasks.push_back(task);
+	}
+	this->queued.fetch_add(1);
+	// Taking the lock guarantees that a worker that has just seen no tasks is already asleep
+	{
+		std::lock_guard<std::mutex> guard(this->sleep);
+	}
+	this->wake.notify_one();
+	return;
+}
+
+
+
+
+
+bool vgs::ThreadPool::run_one(uint32_t const queue_i)
+{
+	// 1. Take the newest task from the own queue or steal the oldest one from somebody else's
+	Task task;
+	bool found = false;
+	for (uint32_t offset = 0; (offset < this->queues.size()) && (!found); ++offset)
+	{
+		Queue &queue = *this->queues[(queue_i + offset) % this->queues.size()];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (queue.tasks.empty())
+			continue;
+		if (offset == 0)
+		{
+			task = queue.tasks.back();
+			queue.tasks.pop_back();
+		}
+		else
+		{
+			task = queue.tasks.front();
+			queue.tasks.pop_front();
+		}
+		found = true;
+	}
+	if (!found)
+		return false;
+	this->queued.fetch_sub(1);
+
+	// 2. Execute it. An exception is kept for the thread that waits for the loop: the chunk
+	//    still has to count as finished, or that thread would never stop waiting
+	try
+	{
+		(*task.loop->body)(task.begin, task.end);
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> guard(task.loop->error_lock);
+		if (!task.loop->error)
+			task.loop->error = std::current_exception();
+	}
+	task.loop->pending.fetch_sub(1, std::memory_order_release);
+	return true;
+}
+
+
+
+
+
+void vgs::ThreadPool::run_loop(uint32_t const queue_i, bool const help, size_t const begin, size_t const end, size_t const grain, vgs::ThreadPool::Body const &body)
+{
+	Loop loop;
+	loop.body = &body;
+	loop.pending.store(0);
+
+	// 1. Queue the chunks. Queued tasks point to this frame, so it must not be left before they
+	//    are all done, not even if queueing fails
+	std::exception_ptr push_error;
+	for (size_t chunk_begin = begin; chunk_begin < end; chunk_begin += grain)
+	{
+		loop.pending.fetch_add(1);
+		try
+		{
+			this->push(queue_i, Task{&loop, chunk_begin, std::min(chunk_begin + grain, end)});
+		}
+		catch (...)
+		{
+			loop.pending.fetch_sub(1);
+			push_error = std::current_exception();
+			break;
+		}
+	}
+
+	// 2. Wait for the chunks, executing tasks in the meantime if asked to
+	while (loop.pending.load(std::memory_order_acquire) > 0)
+		if ((!help) || (!this->run_one(queue_i)))
+			std::this_thread::yield();
+
+	// 3. Report the failure, if any
+	if (push_error)
+		std::rethrow_exception(push_error);
+	if (loop.error)
+		std::rethrow_exception(loop.error);
+	return;
+}
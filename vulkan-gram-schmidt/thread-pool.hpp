@@ -0,0 +1,177 @@
+/**
+ * @file thread-pool.hpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#ifndef __VGS_THREAD_POOL_HPP__
+#define __VGS_THREAD_POOL_HPP__
+
+
+
+
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <cstdint>
+
+
+
+
+
+namespace vgs
+{
+
+
+
+/**
+ * @class ThreadPool
+ * @brief A fixed set of worker threads executing tasks with work stealing.
+ *
+ * Every thread of the pool owns a double-ended queue of tasks. A thread pushes the tasks it creates
+ * to the back of its own queue and takes them back from the back, so that the most recent (and
+ * cache-hot) work is done first; when its queue is empty, it steals the oldest task from the front
+ * of another thread's queue. Threads that wait for their tasks to complete keep executing tasks in
+ * the meantime, hence loops may be nested: a task may start a parallel loop of its own, and
+ * idle threads will join it.
+ *
+ * The calling thread takes part in every loop, so a pool of size \f$t\f$ starts \f$t - 1\f$
+ * worker threads. Threads that do not belong to the pool share one extra queue. On NUMA machines,
+ * the workers are spread evenly over the nodes and bound to them, unless they are all bound to
+ * one node.
+ */
+class ThreadPool final
+{
+
+
+
+private:
+
+	using Body = std::function<void(size_t, size_t)>;
+
+	/**
+	 * @brief State of a parallel loop shared by its chunks
+	 */
+	struct Loop
+	{
+		Body const          *body;
+		std::atomic<size_t>  pending;  // chunks that are queued or running
+		std::mutex           error_lock;
+		std::exception_ptr   error;    // first exception thrown by a chunk
+	};
+
+	/**
+	 * @brief A chunk of a parallel loop
+	 */
+	struct Task
+	{
+		Loop   *loop;
+		size_t  begin;
+		size_t  end;
+	};
+
+	/**
+	 * @brief Tasks of one thread
+	 */
+	struct Queue
+	{
+		std::mutex       lock;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::thread>            workers;
+	std::vector<std::unique_ptr<Queue>> queues;   // queues[0] is shared by the threads outside of the pool
+
+	std::mutex              sleep;        // protects stopping and the sleep of idle workers
+	std::condition_variable wake;
+	std::atomic<size_t>     queued;       // total number of tasks in all queues
+	bool                    stopping;
+
+	void     work(uint32_t const queue_i);
+	uint32_t own_queue(void) const;
+	void     push(uint32_t const queue_i, Task const &task);
+	bool     run_one(uint32_t const queue_i);
+	void     run_loop(uint32_t const queue_i, bool const help, size_t const begin, size_t const end, size_t const grain, Body const &body);
+
+
+
+public:
+
+	/// @name Constructors & destructors
+	/// @{
+
+	/**
+	 * @brief Starts the workers
+	 *
+	 * @param thread_count Total number of threads, including the calling one. 0 means as many
+	 *                     as there are hardware threads.
+	 * @param numa_node NUMA node to bind all the workers to; negative values spread them over
+	 *                  the nodes.
+	 */
+	explicit ThreadPool(uint32_t const thread_count = 0, int32_t const numa_node = -1);
+
+	/**
+	 * @brief Stops and joins the workers
+	 */
+	~ThreadPool(void);
+
+	ThreadPool(ThreadPool const &) = delete;
+	ThreadPool &operator=(ThreadPool const &) = delete;
+
+	/// @}
+
+
+
+	/// @name Execution
+	/// @{
+
+	/**
+	 * @brief Number of threads, including the calling one
+	 */
+	uint32_t size(void) const;
+
+	/**
+	 * @brief Parallel loop
+	 *
+	 * Splits \f$[begin, end)\f$ into chunks of @c grain indices (the last one may be shorter)
+	 * and calls `body(chunk_begin, chunk_end)` for each of them. Every chunk is a separate task.
+	 * Returns when all chunks are processed.
+	 * 
+	 * @c body may call ThreadPool::parallel_for of the same pool.
+	 * 
+	 * @throw Whatever @c body throws first; the other chunks are still processed before that.
+	 */
+	void parallel_for(size_t const begin, size_t const end, size_t const grain, Body const &body);
+
+	/**
+	 * @brief Parallel loop on the workers only
+	 *
+	 * Same as ThreadPool::parallel_for, but a calling thread that does not belong to the pool
+	 * only waits for the chunks instead of processing some of them. Memory first touched by
+	 * @c body is then placed on the nodes of the workers. Falls back to ThreadPool::parallel_for
+	 * if the pool has no workers or is called from one of them.
+	 * 
+	 * @throw Whatever @c body throws first; the other chunks are still processed before that.
+	 */
+	void parallel_for_on_workers(size_t const begin, size_t const end, size_t const grain, Body const &body);
+
+	/// @}
+
+
+
+};
+
+
+
+} // namespace vgs
+
+
+
+
+
+#endif // __VGS_THREAD_POOL_HPP__
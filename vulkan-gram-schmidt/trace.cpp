@@ -0,0 +1,186 @@
+/**
+ * @file trace.cpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#include "trace.hpp"
+
+#ifdef VGS_ENABLE_TRACING
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+
+
+
+
+
+// Storage
+
+
+
+
+
+/**
+ * @brief One complete event of the trace
+ */
+struct TraceEvent
+{
+	char const *name;
+	int64_t     start_ns;
+	int64_t     end_ns;
+	uint32_t    thread_i; // host thread, or GPU track
+	bool        gpu;
+};
+
+
+
+
+
+// Recording stops at this number of events, so that a forgotten trace does not eat all the memory
+static size_t const max_event_count = size_t(1) << 20;
+
+static std::mutex               trace_lock; // protects trace_events and gpu_track_names
+static std::vector<TraceEvent>  trace_events;
+static std::vector<std::string> gpu_track_names;
+static std::atomic<uint32_t>    thread_count(0);
+
+
+
+/**
+ * @brief Small sequential index of the calling thread
+ */
+static uint32_t thread_index(void)
+{
+	thread_local uint32_t const thread_i = thread_count++;
+	return thread_i;
+}
+
+
+
+/**
+ * @brief Nanoseconds on the host clock
+ */
+static int64_t to_ns(std::chrono::steady_clock::time_point const time)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+
+
+/**
+ * @brief Adds an event to the trace, unless it is full
+ */
+static void record(char const *const name, int64_t const start_ns, int64_t const end_ns, uint32_t const thread_i, bool const gpu)
+{
+	std::lock_guard<std::mutex> guard(trace_lock);
+	if (trace_events.size() < max_event_count)
+		trace_events.push_back(TraceEvent{name, start_ns, end_ns, thread_i, gpu});
+	return;
+}
+
+
+
+
+
+// Recording
+
+
+
+
+
+void vgs::trace_host_zone(char const *const name, std::chrono::steady_clock::time_point const start_time, std::chrono::steady_clock::time_point const end_time)
+{
+	record(name, to_ns(start_time), to_ns(end_time), thread_index(), false);
+	return;
+}
+
+
+
+
+
+uint32_t vgs::trace_gpu_track(std::string const &name)
+{
+	std::lock_guard<std::mutex> guard(trace_lock);
+	gpu_track_names.push_back(name + " #" + std::to_string(gpu_track_names.size()));
+	return gpu_track_names.size() - 1;
+}
+
+
+
+
+
+void vgs::trace_gpu_range(char const *const name, uint32_t const track_i, int64_t const start_ns, int64_t const end_ns)
+{
+	record(name, start_ns, end_ns, track_i, true);
+	return;
+}
+
+
+
+
+
+// Export
+
+
+
+
+
+void vgs::write_trace(std::string const &path)
+{
+	std::vector<TraceEvent>  events;
+	std::vector<std::string> track_names;
+	{
+		std::lock_guard<std::mutex> guard(trace_lock);
+		events      = trace_events;
+		track_names = gpu_track_names;
+	}
+
+	// 1. Timestamps are written in microseconds since the first event
+	int64_t origin_ns = 0;
+	if (!events.empty())
+		origin_ns = std::min_element(events.begin(), events.end(), [](TraceEvent const &a, TraceEvent const &b) { return a.start_ns < b.start_ns; })->start_ns;
+
+	// 2. Name the tracks: host threads belong to process 1, the GPU queues to process 2
+	std::ofstream file(path);
+	if (file.fail())
+		throw std::runtime_error("File '" + path + "' cannot be written.");
+	file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+	     << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Host\"}},\n"
+	     << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+	for (uint32_t track_i = 0; track_i < track_names.size(); ++track_i)
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":" << track_i << ",\"args\":{\"name\":\"" << track_names[track_i] << "\"}}";
+
+	// 3. Write the events
+	char buffer[64];
+	for (TraceEvent const &event : events)
+	{
+		file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << (event.gpu ? "gpu" : "host") << "\",\"ph\":\"X\""
+		     << ",\"pid\":" << (event.gpu ? 2 : 1) << ",\"tid\":" << event.thread_i;
+		std::snprintf(buffer, sizeof(buffer), ",\"ts\":%.3f,\"dur\":%.3f}", (event.start_ns - origin_ns) * 1.0e-3, (event.end_ns - event.start_ns) * 1.0e-3);
+		file << buffer;
+	}
+	file << "\n]}\n";
+	if (file.fail())
+		throw std::runtime_error("File '" + path + "' cannot be written.");
+	return;
+}
+
+
+
+
+
+void vgs::clear_trace(void)
+{
+	std::lock_guard<std::mutex> guard(trace_lock);
+	trace_events.clear();
+	return;
+}
+
+
+
+
+
+#endif // VGS_ENABLE_TRACING
@@ -0,0 +1,165 @@
+/**
+ * @file trace.hpp
+ * @author JointPoints, 2021, github.com/jointpoints
+ */
+#ifndef __VGS_TRACE_HPP__
+#define __VGS_TRACE_HPP__
+
+
+
+
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+
+
+
+
+
+namespace vgs
+{
+
+
+
+/**
+ * Whether the library is compiled with @c VGS_ENABLE_TRACING. The macro must be the same for the
+ * library and the code that uses it.
+ */
+#ifdef VGS_ENABLE_TRACING
+constexpr bool trace_enabled = true;
+#else
+constexpr bool trace_enabled = false;
+#endif
+
+
+
+/// @name Recording
+/// @{
+
+#ifdef VGS_ENABLE_TRACING
+
+/**
+ * @brief Records a zone of the calling host thread
+ *
+ * @param name Name of the zone; must be a string literal (or live as long as the trace).
+ * @param start_time Beginning of the zone.
+ * @param end_time End of the zone.
+ */
+void trace_host_zone(char const *const name, std::chrono::steady_clock::time_point const start_time, std::chrono::steady_clock::time_point const end_time);
+
+/**
+ * @brief Creates a track for the GPU ranges of one queue
+ *
+ * Ranges of different queues overlap in time, so every queue needs a track of its own.
+ *
+ * @param name Name of the track in the trace; the number of the track is appended to it.
+ *
+ * @return Number of the track, for vgs::trace_gpu_range.
+ */
+uint32_t trace_gpu_track(std::string const &name);
+
+/**
+ * @brief Records a range of GPU work
+ *
+ * @param name Name of the range; must be a string literal (or live as long as the trace).
+ * @param track_i Track made by vgs::trace_gpu_track.
+ * @param start_ns Beginning of the range on the host clock (@c std::chrono::steady_clock), nanoseconds.
+ * @param end_ns End of the range on the host clock, nanoseconds.
+ */
+void trace_gpu_range(char const *const name, uint32_t const track_i, int64_t const start_ns, int64_t const end_ns);
+
+/**
+ * @class TraceZone
+ * @brief Records a zone of the calling host thread from its construction to its destruction
+ */
+class TraceZone final
+{
+	char const *const                           name;
+	std::chrono::steady_clock::time_point const start_time;
+
+public:
+
+	explicit TraceZone(char const *const name) :
+		name(name),
+		start_time(std::chrono::steady_clock::now())
+	{}
+
+	~TraceZone(void)
+	{
+		trace_host_zone(this->name, this->start_time, std::chrono::steady_clock::now());
+	}
+
+	TraceZone(TraceZone const &) = delete;
+	TraceZone &operator=(TraceZone const &) = delete;
+};
+
+#endif // VGS_ENABLE_TRACING
+
+/// @}
+
+
+
+/// @name Export
+/// @{
+
+#ifdef VGS_ENABLE_TRACING
+
+/**
+ * @brief Writes everything recorded so far as Chrome trace JSON
+ *
+ * The file can be opened in `chrome://tracing` or https://ui.perfetto.dev. Host zones are shown
+ * per thread, GPU ranges per queue.
+ *
+ * @param path File to write.
+ *
+ * @throw std::runtime_error If the file cannot be written.
+ */
+void write_trace(std::string const &path);
+
+/**
+ * @brief Forgets everything recorded so far
+ */
+void clear_trace(void);
+
+#else
+
+inline void write_trace(std::string const &)
+{
+	throw std::runtime_error("Tracing is not available: the library was compiled without VGS_ENABLE_TRACING.");
+}
+
+inline void clear_trace(void)
+{}
+
+#endif // VGS_ENABLE_TRACING
+
+/// @}
+
+
+
+} // namespace vgs
+
+
+
+
+
+// Instrumentation; expands to nothing without VGS_ENABLE_TRACING
+#ifdef VGS_ENABLE_TRACING
+	#define VGS_TRACE_CONCAT_(a, b) a##b
+	#define VGS_TRACE_CONCAT(a, b) VGS_TRACE_CONCAT_(a, b)
+	/// Records a zone from here to the end of the scope
+	#define VGS_TRACE_ZONE(name) vgs::TraceZone const VGS_TRACE_CONCAT(vgs_trace_zone_, __LINE__)(name)
+	/// Records a zone from @c start_time (a @c std::chrono::steady_clock::time_point) to now
+	#define VGS_TRACE_HOST(name, start_time) vgs::trace_host_zone(name, start_time, std::chrono::steady_clock::now())
+#else
+	#define VGS_TRACE_ZONE(name)
+	#define VGS_TRACE_HOST(name, start_time)
+#endif
+
+
+
+
+
+#endif // __VGS_TRACE_HPP__
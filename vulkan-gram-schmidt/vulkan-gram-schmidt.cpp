@@ -6,24 +6,29 @@
 #include <exception>
 #include <cstdlib>
 #include <fstream>
+#include <future>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <limits>
+#include <functional>
+#include <algorithm>
 
 
 
 
 
-#define VK_VALIDATE(func, error_message, unlock_constructor)                \
+#define VK_VALIDATE(func, error_message)                                    \
 	try                                                                     \
 	{                                                                       \
 		VkResult vk_result = func;                                          \
 		if (vk_result != VK_SUCCESS)                                        \
 		{                                                                   \
-			if (unlock_constructor) GPUGramSchmidt::constructor.unlock();   \
 			throw std::runtime_error(std::string("Execution of ") + #func + " has failed with exitcode " + std::to_string(vk_result) + " and the following message:\n\t" + error_message); \
 		}                                                                   \
 	}                                                                       \
 	catch (...)                                                             \
 	{                                                                       \
-		if (unlock_constructor) GPUGramSchmidt::constructor.unlock();       \
 		throw std::runtime_error(std::string("Execution of ") + #func + " has failed with exception and the following message:\n\t" + error_message); \
 	}
 
@@ -34,7 +39,78 @@
 // Initialisation of static members
 std::map<std::pair<uint32_t, uint32_t>, uint32_t> GPUGramSchmidt::vk_busy_queues;
 std::mutex GPUGramSchmidt::constructor;
-std::string GPUGramSchmidt::shader_folder = ".";
+std::map<std::string, GPUGramSchmidt::Profile> GPUGramSchmidt::profiles;
+std::mutex GPUGramSchmidt::profiles_lock;
+std::string GPUGramSchmidt::shader_folder          = ".";
+std::string GPUGramSchmidt::profile_path           = "";
+size_t      GPUGramSchmidt::default_crossover_size = 64;
+double      GPUGramSchmidt::step_timeout           = 60.0;
+
+
+
+
+
+// Work group size of the fixed-size kernel (the default of its local_size_x_id = 0)
+static uint32_t const fixed_workgroup_size = 64;
+
+// Work group size of the probe kernel (the default of its local_size_x_id = 0)
+static uint32_t const probe_workgroup_size = 256;
+
+// Modes of the probe kernel (its constant_id = 1)
+static uint32_t const probe_arithmetic = 0;
+static uint32_t const probe_memory     = 1;
+
+// Largest number of workers that fill and read the buffer on the NUMA node of the GPU
+static size_t const numa_worker_count = 4;
+
+
+
+
+
+/**
+ * @brief Seconds elapsed since the given moment
+ */
+static double seconds_since(std::chrono::steady_clock::time_point const start_time)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+
+
+
+
+/**
+ * @brief Counts matrices processed by the given device in the statistics of a call
+ *
+ * A call whose matrices went to different devices is counted as Backend::hybrid. The matrices
+ * are also counted in the process-wide metrics.
+ */
+static void add_matrices(GPUGramSchmidt::RunStats &stats, GPUGramSchmidt::Backend const backend, uint64_t const matrix_count)
+{
+	stats.backend       = ((stats.matrix_count == 0) || (stats.backend == backend)) ? (backend) : (GPUGramSchmidt::Backend::hybrid);
+	stats.matrix_count += matrix_count;
+	vgs::metrics_add_jobs((backend == GPUGramSchmidt::Backend::cpu) ? (vgs::MetricsDevice::cpu) : ((backend == GPUGramSchmidt::Backend::hybrid) ? (vgs::MetricsDevice::hybrid) : (vgs::MetricsDevice::gpu)), matrix_count);
+	return;
+}
+
+
+
+
+
+/**
+ * @brief Adds the phases of a computation on GPU to the statistics of a call
+ */
+static void add_gpu_phases(GPUGramSchmidt::RunStats &stats, double const allocation_time, double const upload_time, double const compute_time, double const download_time, uint64_t const byte_count)
+{
+	stats.allocation_time  += allocation_time;
+	stats.upload_time      += upload_time;
+	stats.compute_time     += compute_time;
+	stats.download_time    += download_time;
+	stats.bytes_uploaded   += byte_count;
+	stats.bytes_downloaded += byte_count;
+	vgs::metrics_add_transfers(byte_count, byte_count);
+	return;
+}
 
 
 
@@ -46,11 +122,177 @@ std::string GPUGramSchmidt::shader_folder = ".";
 
 
 
-GPUGramSchmidt::GPUGramSchmidt(bool const enable_debug)
+GPUGramSchmidt::GPUGramSchmidt(bool const enable_debug, bool const asynchronous_init, GPUGramSchmidt::Backend const backend) :
+	vk_instance(VK_NULL_HANDLE),
+	vk_physical_device(VK_NULL_HANDLE),
+	vk_device(VK_NULL_HANDLE),
+	vk_compute_shader(VK_NULL_HANDLE),
+	vk_fixed_shader(VK_NULL_HANDLE),
+	vk_probe_shader(VK_NULL_HANDLE),
+	vk_fixed_missing(false),
+	vk_descriptor_set_0_layout(VK_NULL_HANDLE),
+	vk_compute_pipeline_layout(VK_NULL_HANDLE),
+	vk_command_pool(VK_NULL_HANDLE),
+	vk_command_buffer(VK_NULL_HANDLE),
+	vk_descriptor_pool(VK_NULL_HANDLE),
+	vk_descriptor_set_0(VK_NULL_HANDLE),
+	vk_fence(VK_NULL_HANDLE),
+	vk_timestamp_pool(VK_NULL_HANDLE),
+	vk_timestamp_mask(0),
+	vk_step_timed(false),
+	vk_memory_budget(false),
+	vk_matrix_buffer(VK_NULL_HANDLE),
+	vk_matrix_memory(VK_NULL_HANDLE),
+	vk_matrix_capacity(0),
+	vk_matrix_memory_type(-1),
+	vk_numa_node(-1),
+	vk_get_calibrated_timestamps(nullptr),
+	vk_get_executable_properties(nullptr),
+	vk_get_executable_statistics(nullptr),
+	vk_selected_gpu_i(0U - 1),
+	vk_selected_queue_family_i(0U - 1),
+	vk_selected_queues_count(0),
+	vk_ready(false),
+	gpu_timing(false),
+	backend(backend),
+	crossover_size(GPUGramSchmidt::default_crossover_size),
+	cpu_flops(1.0e9),
+	gpu_step_time(1.0e-4),
+	trace_track(0)
+{
+	// 1. The host solver is needed unless the GPU was requested explicitly
+	if (backend != GPUGramSchmidt::Backend::gpu)
+		this->cpu_solver.reset(new CPUGramSchmidt());
+	if (backend == GPUGramSchmidt::Backend::cpu)
+		return;
+
+	// 2. Either set everything up right here or leave the job to a background thread; in the
+	//    latter case GPUGramSchmidt::run will wait for it to finish (or use the CPU meanwhile)
+	if (asynchronous_init)
+		this->vk_initialisation = std::async(std::launch::async, &GPUGramSchmidt::initialise_or_release, this, enable_debug).share();
+	else
+		try
+		{
+			this->initialise_or_release(enable_debug);
+		}
+		catch (std::exception const &)
+		{
+			if (backend == GPUGramSchmidt::Backend::gpu)
+				throw;
+		}
+}
+
+
+
+
+
+GPUGramSchmidt::~GPUGramSchmidt(void)
+{
+	// If the background initialisation is still running, let it finish
+	if (this->vk_initialisation.valid())
+		this->vk_initialisation.wait();
+	this->release();
+}
+
+
+
+
+
+// Initialisation
+
+
+
+
+
+void GPUGramSchmidt::initialise_or_release(bool const enable_debug)
+{
+	try
+	{
+		this->initialise(enable_debug);
+		// Routing between CPU and GPU only makes sense if both are there
+		if (this->uses_routing())
+			this->load_or_calibrate();
+	}
+	catch (...)
+	{
+		this->release();
+		throw;
+	}
+	// Only now may GPUGramSchmidt::run send work to the GPU
+	this->vk_ready = true;
+	return;
+}
+
+
+
+
+
+void GPUGramSchmidt::release(void)
+{
+	// Everything is destroyed in the reverse order of creation; handles that were never created
+	// are null and skipped, so this also cleans up after a failed initialisation
+	this->vk_ready = false;
+	if (this->vk_selected_queues_count > 0)
+	{
+		std::lock_guard<std::mutex> constructor_guard(GPUGramSchmidt::constructor);
+		GPUGramSchmidt::vk_busy_queues[std::make_pair(this->vk_selected_gpu_i, this->vk_selected_queue_family_i)] -= this->vk_selected_queues_count;
+		this->vk_selected_queues_count = 0;
+	}
+	if (this->vk_device != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(this->vk_device, this->vk_timestamp_pool, nullptr);
+		vkDestroyFence(this->vk_device, this->vk_fence, nullptr);
+		vkDestroyBuffer(this->vk_device, this->vk_matrix_buffer, nullptr);
+		vkFreeMemory(this->vk_device, this->vk_matrix_memory, nullptr);
+		if (this->vk_descriptor_set_0 != VK_NULL_HANDLE)
+			vkFreeDescriptorSets(this->vk_device, this->vk_descriptor_pool, 1, &this->vk_descriptor_set_0);
+		vkDestroyDescriptorPool(this->vk_device, this->vk_descriptor_pool, nullptr);
+		if (this->vk_command_buffer != VK_NULL_HANDLE)
+			vkFreeCommandBuffers(this->vk_device, this->vk_command_pool, 1, &this->vk_command_buffer);
+		vkDestroyCommandPool(this->vk_device, this->vk_command_pool, nullptr);
+		for (auto &vk_compute_pipeline : this->vk_compute_pipelines)
+			vkDestroyPipeline(this->vk_device, vk_compute_pipeline.second, nullptr);
+		for (auto &vk_fixed_pipeline : this->vk_fixed_pipelines)
+			vkDestroyPipeline(this->vk_device, vk_fixed_pipeline.second, nullptr);
+		for (auto &vk_probe_pipeline : this->vk_probe_pipelines)
+			vkDestroyPipeline(this->vk_device, vk_probe_pipeline.second, nullptr);
+		vkDestroyPipelineLayout(this->vk_device, this->vk_compute_pipeline_layout, nullptr);
+		vkDestroyDescriptorSetLayout(this->vk_device, this->vk_descriptor_set_0_layout, nullptr);
+		vkDestroyShaderModule(this->vk_device, this->vk_probe_shader, nullptr);
+		vkDestroyShaderModule(this->vk_device, this->vk_fixed_shader, nullptr);
+		vkDestroyShaderModule(this->vk_device, this->vk_compute_shader, nullptr);
+		vkDestroyDevice(this->vk_device, nullptr);
+	}
+	if (this->vk_instance != VK_NULL_HANDLE)
+		vkDestroyInstance(this->vk_instance, nullptr);
+	this->numa_pool.reset();
+	this->vk_compute_pipelines.clear();
+	this->vk_fixed_pipelines.clear();
+	this->vk_probe_pipelines.clear();
+	this->vk_fixed_shader              = VK_NULL_HANDLE;
+	this->vk_probe_shader              = VK_NULL_HANDLE;
+	this->vk_fixed_missing             = false;
+	this->vk_timestamp_pool            = VK_NULL_HANDLE;
+	this->vk_get_calibrated_timestamps = nullptr;
+	this->vk_get_executable_properties = nullptr;
+	this->vk_get_executable_statistics = nullptr;
+	this->vk_memory_budget             = false;
+	this->vk_matrix_capacity           = 0;
+	this->vk_matrix_memory_type        = -1;
+	this->vk_device                    = VK_NULL_HANDLE;
+	this->vk_instance                  = VK_NULL_HANDLE;
+	return;
+}
+
+
+
+
+
+void GPUGramSchmidt::initialise(bool const enable_debug)
 {
 	// 1. Lock the constructor mutex so that no two GPUGramSchmidt objects are constructed at the
-	//    same time.
-	GPUGramSchmidt::constructor.lock();
+	//    same time. The lock is released on every error as well.
+	std::unique_lock<std::mutex> constructor_guard(GPUGramSchmidt::constructor);
 
 	// 2. Create Vulkan Instance
 	//   2.1. Define necessary metadata for Vulkan Instance
@@ -86,7 +328,7 @@ GPUGramSchmidt::GPUGramSchmidt(bool const enable_debug)
 		throw std::runtime_error("Vulkan 1.2 is not supported by this machine.");
 	//     2.2.2. If vkEnumerateInstanceVersion is available, we may call it and check the version
 	uint32_t vk_api_version = 0;
-	VK_VALIDATE(  vkEnumerateInstanceVersion(&vk_api_version), "Unable to identify available Vulkan version.", true  );
+	VK_VALIDATE(  vkEnumerateInstanceVersion(&vk_api_version), "Unable to identify available Vulkan version."  );
 	if (vk_api_version < vk_api_req_version)
 		throw std::runtime_error("Vulkan 1.2 is not supported by this machine.");
 	//   2.3. If debugging is required, check availability of debug layers
@@ -110,14 +352,14 @@ GPUGramSchmidt::GPUGramSchmidt(bool const enable_debug)
 		}
 	}
 	//   2.4. If all explicit checks are passed, we may proceed to the creation of Instance itself
-	VK_VALIDATE(  vkCreateInstance(&vk_instance_info, nullptr, &this->vk_instance), "Vulkan Instance creation failed.", true  );
+	VK_VALIDATE(  vkCreateInstance(&vk_instance_info, nullptr, &this->vk_instance), "Vulkan Instance creation failed."  );
 
 	// 3. Find suitable physical device
 	//   3.1. Enumerate all physical devices (GPUs) available to the Vulkan Instance
 	uint32_t vk_gpus_count = 0;
-	VK_VALIDATE(  vkEnumeratePhysicalDevices(this->vk_instance, &vk_gpus_count, nullptr), "Physical device enumeration failed.", true  );
+	VK_VALIDATE(  vkEnumeratePhysicalDevices(this->vk_instance, &vk_gpus_count, nullptr), "Physical device enumeration failed."  );
 	VkPhysicalDevice vk_gpus[vk_gpus_count];
-	VK_VALIDATE(  vkEnumeratePhysicalDevices(this->vk_instance, &vk_gpus_count, vk_gpus), "Physical device enumeration failed.", true  );
+	VK_VALIDATE(  vkEnumeratePhysicalDevices(this->vk_instance, &vk_gpus_count, vk_gpus), "Physical device enumeration failed."  );
 	//   3.2. Analyse queues of each GPU. We're looking for queues that can exclusively do
 	//        computations. If we can't find such queues, we select queues that can at least do
 	//        computations.
@@ -182,12 +424,117 @@ GPUGramSchmidt::GPUGramSchmidt(bool const enable_debug)
 		.pEnabledFeatures        = &vk_gpu_features // nullptr
 	};
 	this->vk_physical_device = vk_gpus[this->vk_selected_gpu_i];
-	VK_VALIDATE(  vkCreateDevice(this->vk_physical_device, &vk_device_info, nullptr, &this->vk_device), "Logical device creation failed.", true  );
+	vkGetPhysicalDeviceProperties(this->vk_physical_device, &this->vk_physical_device_properties);
+	// GPU timestamps can only be written if the queue family reports valid bits for them
+	uint32_t const vk_timestamp_bits = vk_queue_properties[this->vk_selected_gpu_i][this->vk_selected_queue_family_i].timestampValidBits;
+	this->vk_timestamp_mask = (vk_timestamp_bits >= 64) ? (~uint64_t(0)) : ((uint64_t(1) << vk_timestamp_bits) - 1);
+	// The host memory shared with the GPU is best placed on the NUMA node the GPU is attached to;
+	// the node can be found by the PCI address of the GPU, if the driver reports it
+	uint32_t vk_device_extensions_count = 0;
+	vkEnumerateDeviceExtensionProperties(this->vk_physical_device, nullptr, &vk_device_extensions_count, nullptr);
+	std::vector<VkExtensionProperties> vk_device_extensions(vk_device_extensions_count);
+	vkEnumerateDeviceExtensionProperties(this->vk_physical_device, nullptr, &vk_device_extensions_count, vk_device_extensions.data());
+	for (VkExtensionProperties const &vk_extension : vk_device_extensions)
+		if (strcmp(vk_extension.extensionName, "VK_EXT_pci_bus_info") == 0)
+		{
+			VkPhysicalDevicePCIBusInfoPropertiesEXT vk_pci_bus_info =
+			{
+				.sType       = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PCI_BUS_INFO_PROPERTIES_EXT,
+				.pNext       = nullptr,
+				.pciDomain   = 0,
+				.pciBus      = 0,
+				.pciDevice   = 0,
+				.pciFunction = 0
+			};
+			VkPhysicalDeviceProperties2 vk_properties =
+			{
+				.sType      = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+				.pNext      = &vk_pci_bus_info,
+				.properties = {}
+			};
+			vkGetPhysicalDeviceProperties2(this->vk_physical_device, &vk_properties);
+			this->vk_numa_node = vgs::pci_numa_node(vk_pci_bus_info.pciDomain, vk_pci_bus_info.pciBus, vk_pci_bus_info.pciDevice, vk_pci_bus_info.pciFunction);
+			break;
+		}
+	// The device memory used by the process is reported by VK_EXT_memory_budget, if supported
+	std::vector<char const *> vk_enabled_extensions;
+	char const *const vk_budget_extension = "VK_EXT_memory_budget";
+	for (VkExtensionProperties const &vk_extension : vk_device_extensions)
+		if (strcmp(vk_extension.extensionName, vk_budget_extension) == 0)
+		{
+			vk_enabled_extensions.push_back(vk_budget_extension);
+			this->vk_memory_budget = true;
+			break;
+		}
+	// Statistics of the compiled kernels are reported by VK_KHR_pipeline_executable_properties, if
+	// supported; the feature only matters to pipelines created with the capture flag
+	VkPhysicalDevicePipelineExecutablePropertiesFeaturesKHR vk_executable_features =
+	{
+		.sType                  = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_EXECUTABLE_PROPERTIES_FEATURES_KHR,
+		.pNext                  = nullptr,
+		.pipelineExecutableInfo = VK_FALSE
+	};
+	char const *const vk_executable_extension = "VK_KHR_pipeline_executable_properties";
+	for (VkExtensionProperties const &vk_extension : vk_device_extensions)
+		if (strcmp(vk_extension.extensionName, vk_executable_extension) == 0)
+		{
+			VkPhysicalDeviceFeatures2 vk_features =
+			{
+				.sType    = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+				.pNext    = &vk_executable_features,
+				.features = {}
+			};
+			vkGetPhysicalDeviceFeatures2(this->vk_physical_device, &vk_features);
+			if (vk_executable_features.pipelineExecutableInfo == VK_TRUE)
+			{
+				vk_enabled_extensions.push_back(vk_executable_extension);
+				vk_device_info.pNext = &vk_executable_features;
+			}
+			break;
+		}
+	bool vk_calibration = false;
+#ifdef VGS_ENABLE_TRACING
+	// GPU ranges of the trace are put on the host clock by VK_EXT_calibrated_timestamps, if the
+	// driver can correlate the GPU clock with CLOCK_MONOTONIC (the clock of std::chrono::steady_clock)
+	char const *const vk_calibration_extension = "VK_EXT_calibrated_timestamps";
+	for (VkExtensionProperties const &vk_extension : vk_device_extensions)
+		if (strcmp(vk_extension.extensionName, vk_calibration_extension) == 0)
+		{
+			auto const vk_get_time_domains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(vkGetInstanceProcAddr(this->vk_instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+			uint32_t vk_time_domains_count = 0;
+			if (vk_get_time_domains != nullptr)
+				vk_get_time_domains(this->vk_physical_device, &vk_time_domains_count, nullptr);
+			std::vector<VkTimeDomainEXT> vk_time_domains(vk_time_domains_count);
+			if (vk_time_domains_count > 0)
+				vk_get_time_domains(this->vk_physical_device, &vk_time_domains_count, vk_time_domains.data());
+			if ((std::find(vk_time_domains.begin(), vk_time_domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != vk_time_domains.end()) &&
+			    (std::find(vk_time_domains.begin(), vk_time_domains.end(), VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT) != vk_time_domains.end()))
+			{
+				vk_enabled_extensions.push_back(vk_calibration_extension);
+				vk_calibration = true;
+			}
+			break;
+		}
+#endif // VGS_ENABLE_TRACING
+	vk_device_info.enabledExtensionCount   = vk_enabled_extensions.size();
+	vk_device_info.ppEnabledExtensionNames = vk_enabled_extensions.data();
+	VK_VALIDATE(  vkCreateDevice(this->vk_physical_device, &vk_device_info, nullptr, &this->vk_device), "Logical device creation failed."  );
+	if (vk_calibration)
+		this->vk_get_calibrated_timestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(vkGetDeviceProcAddr(this->vk_device, "vkGetCalibratedTimestampsEXT"));
+	if (vk_device_info.pNext == &vk_executable_features)
+	{
+		this->vk_get_executable_properties = reinterpret_cast<PFN_vkGetPipelineExecutablePropertiesKHR>(vkGetDeviceProcAddr(this->vk_device, "vkGetPipelineExecutablePropertiesKHR"));
+		this->vk_get_executable_statistics = reinterpret_cast<PFN_vkGetPipelineExecutableStatisticsKHR>(vkGetDeviceProcAddr(this->vk_device, "vkGetPipelineExecutableStatisticsKHR"));
+	}
 
 	// 5. Get Vulkan Queues associated with this Vulkan Device
 	this->vk_queues.resize(this->vk_selected_queues_count);
 	for (uint32_t queue_i = 0; queue_i < this->vk_selected_queues_count; ++queue_i)
 		vkGetDeviceQueue(this->vk_device, this->vk_selected_queue_family_i, queue_i, this->vk_queues.data() + queue_i);
+#ifdef VGS_ENABLE_TRACING
+	// Every solver has a queue of its own, so its dispatches get a track of their own
+	this->trace_track = vgs::trace_gpu_track(std::string(this->vk_physical_device_properties.deviceName) + ", queue family " + std::to_string(this->vk_selected_queue_family_i));
+#endif // VGS_ENABLE_TRACING
 	
 	// 6. Load the precompiled compute shader
 	//   6.1. Open the file and fetch the bytes 
@@ -209,7 +556,7 @@ GPUGramSchmidt::GPUGramSchmidt(bool const enable_debug)
 		.codeSize = compute_shader_bytes.size(),
 		.pCode    = reinterpret_cast<uint32_t const *>(compute_shader_bytes.data())
 	};
-	VK_VALIDATE(  vkCreateShaderModule(this->vk_device, &vk_compute_shader_info, nullptr, &this->vk_compute_shader), "Compute shader module creation failed.", true  );
+	VK_VALIDATE(  vkCreateShaderModule(this->vk_device, &vk_compute_shader_info, nullptr, &this->vk_compute_shader), "Compute shader module creation failed."  );
 
 	// 7. Prepare metadata for computations
 	//   7.1. Describe the binding for the matrix (descriptor set 0, binding 0)
@@ -230,7 +577,7 @@ GPUGramSchmidt::GPUGramSchmidt(bool const enable_debug)
 		.bindingCount = 1,
 		.pBindings    = &vk_descriptor_set_0_binding_0
 	};
-	VK_VALIDATE(  vkCreateDescriptorSetLayout(this->vk_device, &vk_descriptor_set_0_layout_info, nullptr, &this->vk_descriptor_set_0_layout), "Descriptor set 0 layout creation failed.", true  );
+	VK_VALIDATE(  vkCreateDescriptorSetLayout(this->vk_device, &vk_descriptor_set_0_layout_info, nullptr, &this->vk_descriptor_set_0_layout), "Descriptor set 0 layout creation failed."  );
 	//   7.3. Describe push constants ranges (dim, vector_count, start_dim_i)
 	VkPushConstantRange const vk_push_constant_range =
 	{
@@ -249,30 +596,10 @@ GPUGramSchmidt::GPUGramSchmidt(bool const enable_debug)
 		.pushConstantRangeCount = 1,
 		.pPushConstantRanges    = &vk_push_constant_range
 	};
-	VK_VALIDATE(  vkCreatePipelineLayout(this->vk_device, &vk_compute_pipeline_layout_info, nullptr, &this->vk_compute_pipeline_layout), "Compute pipeline layout creation failed.", true  );
+	VK_VALIDATE(  vkCreatePipelineLayout(this->vk_device, &vk_compute_pipeline_layout_info, nullptr, &this->vk_compute_pipeline_layout), "Compute pipeline layout creation failed."  );
 
-	// 8. Create compute pipeline
-	VkPipelineShaderStageCreateInfo const vk_shader_stage_info =
-	{
-		.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-		.pNext               = nullptr,
-		.flags               = 0,
-		.stage               = VK_SHADER_STAGE_COMPUTE_BIT,
-		.module              = this->vk_compute_shader,
-		.pName               = "main",
-		.pSpecializationInfo = nullptr
-	};
-	VkComputePipelineCreateInfo const vk_compute_pipeline_info =
-	{
-		.sType              = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-		.pNext              = nullptr,
-		.flags              = 0, // VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT,
-		.stage              = vk_shader_stage_info,
-		.layout             = this->vk_compute_pipeline_layout,
-		.basePipelineHandle = VK_NULL_HANDLE,
-		.basePipelineIndex  = -1
-	};
-	VK_VALIDATE(  vkCreateComputePipelines(this->vk_device, VK_NULL_HANDLE, 1, &vk_compute_pipeline_info, nullptr, &this->vk_compute_pipeline), "Compute pipeline creation failed.", true  );
+	// 8. Create compute pipeline for the default variant; others will be created on demand
+	this->vk_compute_pipelines[this->variant.workgroup_size] = this->create_compute_pipeline(this->variant);
 	
 	// 9. Create command pool from where buffers will be allocated
 	VkCommandPoolCreateInfo const vk_command_pool_info =
@@ -282,7 +609,7 @@ GPUGramSchmidt::GPUGramSchmidt(bool const enable_debug)
 		.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
 		.queueFamilyIndex = this->vk_selected_queue_family_i
 	};
-	VK_VALIDATE(  vkCreateCommandPool(this->vk_device, &vk_command_pool_info, nullptr, &this->vk_command_pool), "Command pool creation failed.", true  );
+	VK_VALIDATE(  vkCreateCommandPool(this->vk_device, &vk_command_pool_info, nullptr, &this->vk_command_pool), "Command pool creation failed."  );
 
 	// 10. Create a command buffer
 	VkCommandBufferAllocateInfo const vk_command_buffer_info =
@@ -293,7 +620,7 @@ GPUGramSchmidt::GPUGramSchmidt(bool const enable_debug)
 		.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
 		.commandBufferCount = 1
 	};
-	VK_VALIDATE(  vkAllocateCommandBuffers(this->vk_device, &vk_command_buffer_info, &this->vk_command_buffer), "Command buffer was not allocated.", true  );
+	VK_VALIDATE(  vkAllocateCommandBuffers(this->vk_device, &vk_command_buffer_info, &this->vk_command_buffer), "Command buffer was not allocated."  );
 	
 	// 11. Create descriptor pool from where descriptor sets will be allocated
 	VkDescriptorPoolSize const vk_descriptor_pool_size_storage_buffers =
@@ -310,7 +637,7 @@ GPUGramSchmidt::GPUGramSchmidt(bool const enable_debug)
 		.poolSizeCount = 1,
 		.pPoolSizes    = &vk_descriptor_pool_size_storage_buffers
 	};
-	VK_VALIDATE(  vkCreateDescriptorPool(this->vk_device, &vk_descriptor_pool_info, nullptr, &this->vk_descriptor_pool), "Descriptor pool creation failed.", true  );
+	VK_VALIDATE(  vkCreateDescriptorPool(this->vk_device, &vk_descriptor_pool_info, nullptr, &this->vk_descriptor_pool), "Descriptor pool creation failed."  );
 
 	// 12. Create a descriptor set (set = 0, binding = 0)
 	VkDescriptorSetAllocateInfo const vk_descriptor_set_0_info =
@@ -321,7 +648,7 @@ GPUGramSchmidt::GPUGramSchmidt(bool const enable_debug)
 		.descriptorSetCount = 1,
 		.pSetLayouts        = &vk_descriptor_set_0_layout
 	};
-	VK_VALIDATE(  vkAllocateDescriptorSets(this->vk_device, &vk_descriptor_set_0_info, &this->vk_descriptor_set_0), "Descriptor set 0 allocation failed.", true  );
+	VK_VALIDATE(  vkAllocateDescriptorSets(this->vk_device, &vk_descriptor_set_0_info, &this->vk_descriptor_set_0), "Descriptor set 0 allocation failed."  );
 
 	// 13. Create a fence to signal after each workload
 	VkFenceCreateInfo const vk_fence_info =
@@ -330,128 +657,866 @@ GPUGramSchmidt::GPUGramSchmidt(bool const enable_debug)
 		.pNext = nullptr,
 		.flags = 0
 	};
-	VK_VALIDATE(  vkCreateFence(this->vk_device, &vk_fence_info, nullptr, &this->vk_fence), "Fence creation failed.", true  );
+	VK_VALIDATE(  vkCreateFence(this->vk_device, &vk_fence_info, nullptr, &this->vk_fence), "Fence creation failed."  );
+
+	// 14. Create a pool of two timestamps (before and after a step) for GPU timing, if the queue
+	//     can write them
+	if (this->vk_timestamp_mask != 0)
+	{
+		VkQueryPoolCreateInfo const vk_timestamp_pool_info =
+		{
+			.sType              = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.pNext              = nullptr,
+			.flags              = 0, // reserved
+			.queryType          = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount         = 2,
+			.pipelineStatistics = 0  // ignored for timestamps
+		};
+		VK_VALIDATE(  vkCreateQueryPool(this->vk_device, &vk_timestamp_pool_info, nullptr, &this->vk_timestamp_pool), "Timestamp query pool creation failed."  );
+	}
+
+	// 15. Unlock constructor mutex
+	constructor_guard.unlock();
+
+	// 16. The topology is read once; the buffer is then filled and read by a few workers that
+	//     stay on the node of the GPU
+	if ((this->vk_numa_node >= 0) && (vgs::numa_nodes().size() > 1))
+	{
+		size_t const node_cpu_count = vgs::numa_node_cpus(this->vk_numa_node).size();
+		if (node_cpu_count > 0)
+			this->numa_pool.reset(new vgs::ThreadPool(std::min(node_cpu_count, numa_worker_count) + 1, this->vk_numa_node));
+	}
+	return;
+}
+
+
+
+
 
-	// 14. Unlock constructor mutex
-	GPUGramSchmidt::constructor.unlock();
+bool GPUGramSchmidt::is_ready(void) const
+{
+	return this->vk_ready;
 }
 
 
 
 
 
-GPUGramSchmidt::~GPUGramSchmidt(void)
+GPUGramSchmidt::Backend GPUGramSchmidt::get_backend(void) const
 {
-	GPUGramSchmidt::vk_busy_queues[std::make_pair(this->vk_selected_gpu_i, this->vk_selected_queue_family_i)] -= this->vk_selected_queues_count;
-	vkDestroyFence(this->vk_device, this->vk_fence, nullptr);
-	vkFreeDescriptorSets(this->vk_device, this->vk_descriptor_pool, 1, &this->vk_descriptor_set_0);
-	vkDestroyDescriptorPool(this->vk_device, this->vk_descriptor_pool, nullptr);
-	vkFreeCommandBuffers(this->vk_device, this->vk_command_pool, 1, &this->vk_command_buffer);
-	vkDestroyCommandPool(this->vk_device, this->vk_command_pool, nullptr);
-	vkDestroyPipeline(this->vk_device, this->vk_compute_pipeline, nullptr);
-	vkDestroyPipelineLayout(this->vk_device, this->vk_compute_pipeline_layout, nullptr);
-	vkDestroyDescriptorSetLayout(this->vk_device, this->vk_descriptor_set_0_layout, nullptr);
-	vkDestroyShaderModule(this->vk_device, this->vk_compute_shader, nullptr);
-	vkDestroyDevice(this->vk_device, nullptr);
-	vkDestroyInstance(this->vk_instance, nullptr);
+	if (this->backend == GPUGramSchmidt::Backend::gpu)
+		return GPUGramSchmidt::Backend::gpu;
+	if (!this->vk_ready)
+		return GPUGramSchmidt::Backend::cpu;
+	return (this->backend == GPUGramSchmidt::Backend::hybrid) ? (GPUGramSchmidt::Backend::hybrid) : (GPUGramSchmidt::Backend::gpu);
 }
 
 
 
 
 
-// Computations
+std::string GPUGramSchmidt::get_device_name(void) const
+{
+	if (!this->vk_ready)
+		return "";
+	return this->vk_physical_device_properties.deviceName;
+}
 
 
 
 
 
-void GPUGramSchmidt::run(GPUGramSchmidt::Matrix &matrix, bool const vectors_as_columns)
+bool GPUGramSchmidt::await_gpu(void) const
 {
-	// 1. Create buffer for the matrix
-	//   1.1. Create handle for the storage buffer
-	VkBuffer vk_matrix_buffer;
-	VkBufferCreateInfo const vk_matrix_buffer_info =
+	// Only an explicitly requested GPU makes initialisation errors fatal
+	if (this->backend == GPUGramSchmidt::Backend::gpu)
+		this->wait_until_ready();
+	else if (this->vk_initialisation.valid())
+		this->vk_initialisation.wait();
+	return this->vk_ready;
+}
+
+
+
+
+
+void GPUGramSchmidt::wait_until_ready(void) const
+{
+	// shared_future::get rethrows whatever the background initialisation has thrown
+	if (this->vk_initialisation.valid())
+		this->vk_initialisation.get();
+	if (!this->vk_ready)
+		throw std::runtime_error("The GPU is not usable: a step has timed out.");
+	return;
+}
+
+
+
+
+
+void GPUGramSchmidt::warm_up(std::vector<size_t> const &sizes, std::vector<GPUGramSchmidt::Variant> const &variants)
+{
+	// 1. Make sure the GPU has been set up; there is nothing to warm up without it
+	if (!this->await_gpu())
+		return;
+
+	// 2. Compile pipelines for all the requested variants
+	for (auto const &variant : variants)
+		this->get_compute_pipeline(variant);
+
+	// 3. Allocate device memory for the largest expected matrix
+	size_t max_size = 0;
+	for (size_t const size : sizes)
+		max_size = std::max(max_size, size);
+	if (max_size > 0)
+		this->reserve_matrix_memory(max_size * max_size * 8);
+
+	// 4. Push a tiny workload through every variant so that the driver finishes all the deferred
+	//    work before the first real call
+	for (auto const &variant : variants)
 	{
-		.sType                 = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-		.pNext                 = nullptr,
-		.flags                 = 0,
-		.size                  = matrix.size() * matrix.size() * 8,
-		.usage                 = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-		.sharingMode           = VK_SHARING_MODE_EXCLUSIVE,
-		.queueFamilyIndexCount = 1,
-		.pQueueFamilyIndices   = &this->vk_selected_queue_family_i // ignored due to VK_SHARING_MODE_EXCLUSIVE
-	};
-	VK_VALIDATE(  vkCreateBuffer(this->vk_device, &vk_matrix_buffer_info, nullptr, &vk_matrix_buffer), "Matrix buffer creation failed.", false  );
-	//   1.2. Get the device memory requirements for the buffer
-	VkMemoryRequirements vk_matrix_buffer_memory_reqs;
-	vkGetBufferMemoryRequirements(this->vk_device, vk_matrix_buffer, &vk_matrix_buffer_memory_reqs);
+		GPUGramSchmidt::Matrix dummy{{1.0, 0.0},
+		                             {0.0, 1.0}};
+		this->run_variant(dummy, false, variant);
+	}
 
-	// 2. Allocate device memory for computations
-	//   2.1. Find a suitable memory type
-	VkPhysicalDeviceMemoryProperties vk_device_memory_properties;
-	vkGetPhysicalDeviceMemoryProperties(this->vk_physical_device, &vk_device_memory_properties);
-	//   2.2. Try to find memory type with needed properties and enough free space
-	VkDeviceMemory vk_matrix_memory;
-	bool allocation_success = false;
-	for (uint32_t memory_type_i = 0; memory_type_i < vk_device_memory_properties.memoryTypeCount; ++memory_type_i)
+	return;
+}
+
+
+
+
+
+void GPUGramSchmidt::warm_up(std::vector<size_t> const &sizes)
+{
+	this->warm_up(sizes, {this->variant});
+	return;
+}
+
+
+
+
+
+// CPU/GPU routing
+
+
+
+
+
+std::string GPUGramSchmidt::get_profile_key(void) const
+{
+	std::ostringstream profile_key;
+	profile_key << this->vk_physical_device_properties.deviceName << '\t' << this->vk_physical_device_properties.driverVersion << '\t' << this->cpu_solver->thread_count() << '\t';
+	return profile_key.str();
+}
+
+
+
+
+
+void GPUGramSchmidt::load_or_calibrate(void)
+{
+	std::string const           profile_key = this->get_profile_key();
+	std::lock_guard<std::mutex> profiles_guard(GPUGramSchmidt::profiles_lock);
+
+	// 1. Another solver on the same GPU may already have measured it
+	auto const profile = GPUGramSchmidt::profiles.find(profile_key);
+	if (profile != GPUGramSchmidt::profiles.end())
 	{
-		if (((vk_device_memory_properties.memoryTypes[memory_type_i].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0) ||
-		    ((vk_device_memory_properties.memoryTypes[memory_type_i].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) ||
-		    ((vk_device_memory_properties.memoryTypes[memory_type_i].propertyFlags & vk_matrix_buffer_memory_reqs.memoryTypeBits) == 0) ||
-		    (vk_device_memory_properties.memoryHeaps[vk_device_memory_properties.memoryTypes[memory_type_i].heapIndex].size < vk_matrix_buffer_memory_reqs.size))
-			continue;
-		VkMemoryAllocateInfo const vk_memory_info =
-		{
-			.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-			.pNext           = nullptr,
-			.allocationSize  = vk_matrix_buffer_memory_reqs.size, // matrix.size() * matrix.size() * 8,
-			.memoryTypeIndex = memory_type_i
-		};
-		if (vkAllocateMemory(this->vk_device, &vk_memory_info, nullptr, &vk_matrix_memory) == VK_SUCCESS)
+		this->crossover_size = profile->second.crossover_size;
+		this->cpu_flops      = profile->second.cpu_flops;
+		this->gpu_step_time  = profile->second.gpu_step_time;
+		return;
+	}
+
+	// 2. Without a profile file, keep GPUGramSchmidt::default_crossover_size until
+	//    GPUGramSchmidt::calibrate is called
+	if (GPUGramSchmidt::profile_path.empty())
+		return;
+
+	// 3. Look for the crossover order (and the measured rates) in the profile
+	std::ifstream profile_reader(GPUGramSchmidt::profile_path);
+	std::string   profile_line;
+	while (std::getline(profile_reader, profile_line))
+		if (profile_line.compare(0, profile_key.size(), profile_key) == 0)
 		{
-			allocation_success = true;
-			break;
+			std::istringstream profile_values(profile_line.substr(profile_key.size()));
+			size_t crossover_size = 0;
+			profile_values >> crossover_size >> this->cpu_flops >> this->gpu_step_time;
+			this->crossover_size = crossover_size;
+			GPUGramSchmidt::profiles[profile_key] = {crossover_size, this->cpu_flops, this->gpu_step_time};
+			return;
 		}
-	}
-	if (allocation_success == false)
-		throw std::runtime_error("Unable to allocate memory on your GPU.");
-	
-	// 3. Bind memory with the buffer
-	VK_VALIDATE(  vkBindBufferMemory(this->vk_device, vk_matrix_buffer, vk_matrix_memory, 0), "Device memory association with the matrix buffer failed.", false  );
 
-	// 4. Fill the buffer with the matrix data
-	double *payload = nullptr;
-	vkMapMemory(this->vk_device, vk_matrix_memory, 0, matrix.size() * matrix.size() * 8, 0, reinterpret_cast<void **>(&payload));
-	for (uint32_t i = 0; i < matrix.size(); ++i)
-		for (uint32_t j = 0; j < matrix.size(); ++j)
-			payload[i * matrix.size() + j] = vectors_as_columns ? matrix[j][i] : matrix[i][j];
-	vkUnmapMemory(this->vk_device, vk_matrix_memory);
+	// 4. If there is none, measure it and remember for the next time
+	this->calibrate_unchecked();
+	GPUGramSchmidt::profiles[profile_key] = {this->crossover_size, this->cpu_flops, this->gpu_step_time};
+	std::ofstream profile_writer(GPUGramSchmidt::profile_path, std::ios_base::app);
+	profile_writer << profile_key << this->crossover_size << '\t' << this->cpu_flops << '\t' << this->gpu_step_time << '\n';
+	return;
+}
 
-	// 5. Associate the buffer with the descriptor set binding
-	VkDescriptorBufferInfo const vk_matrix_buffer_descriptor_info =
+
+
+
+
+void GPUGramSchmidt::calibrate_unchecked(void)
+{
+	// Orders are doubled until the GPU beats the CPU on two consecutive orders. If it never
+	// happens, the GPU is assumed to win beyond the largest order tried
+	size_t const max_size    = 512;
+	size_t       gpu_wins    = 0;
+	std::default_random_engine             generator(0);
+	std::uniform_real_distribution<double> pseudorandom(-1.0, 1.0);
+	auto const best_runtime = [](std::function<void(GPUGramSchmidt::Matrix &)> const &solve, GPUGramSchmidt::Matrix const &matrix)
 	{
-		.buffer = vk_matrix_buffer,
-		.offset = 0,
-		.range  = VK_WHOLE_SIZE
+		double best = std::numeric_limits<double>::infinity();
+		for (uint8_t repeat_i = 0; repeat_i < 3; ++repeat_i)
+		{
+			GPUGramSchmidt::Matrix matrix_copy(matrix);
+			auto const start_time = std::chrono::steady_clock::now();
+			solve(matrix_copy);
+			best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+		}
+		return best;
 	};
-	VkWriteDescriptorSet const vk_write_descriptor_set_0 =
+	this->crossover_size = 2 * max_size;
+	for (size_t n = 2; n <= max_size; n *= 2)
 	{
-		.sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-		.pNext            = nullptr,
-		.dstSet           = this->vk_descriptor_set_0,
-		.dstBinding       = 0,
-		.dstArrayElement  = 0,
-		.descriptorCount  = 1,
-		.descriptorType   = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-		.pImageInfo       = nullptr,
-		.pBufferInfo      = &vk_matrix_buffer_descriptor_info,
-		.pTexelBufferView = nullptr
-	};
-	vkUpdateDescriptorSets(this->vk_device, 1, &vk_write_descriptor_set_0, 0, nullptr);
+		// Diagonal dominance keeps the matrix non-singular
+		GPUGramSchmidt::Matrix matrix(n, std::vector<double>(n));
+		for (size_t i = 0; i < n; ++i)
+			for (size_t j = 0; j < n; ++j)
+				matrix[i][j] = pseudorandom(generator) + ((i == j) ? (n) : (0.0));
+		double const cpu_runtime = best_runtime([this](GPUGramSchmidt::Matrix &m) { this->cpu_solver->run(m); }, matrix);
+		double const gpu_runtime = best_runtime([this](GPUGramSchmidt::Matrix &m) { this->run_variant(m, false, this->variant); }, matrix);
+		// Rates at the largest order tried are the starting point for the hybrid mode: MGS
+		// takes about 2n^3 flops, the GPU makes n submissions
+		this->cpu_flops     = 2.0 * n * n * n / cpu_runtime;
+		this->gpu_step_time = gpu_runtime / n;
+		gpu_wins = (gpu_runtime < cpu_runtime) ? (gpu_wins + 1) : (0);
+		if (gpu_wins == 2)
+		{
+			this->crossover_size = n / 2;
+			break;
+		}
+	}
+	return;
+}
 
-	// 6. Record and submit commands into the command buffer
-	//   6.1. Start buffer recording
+
+
+
+
+void GPUGramSchmidt::calibrate(void)
+{
+	if ((this->uses_routing()) && (this->await_gpu()))
+	{
+		std::string const           profile_key = this->get_profile_key();
+		std::lock_guard<std::mutex> profiles_guard(GPUGramSchmidt::profiles_lock);
+		this->calibrate_unchecked();
+		GPUGramSchmidt::profiles[profile_key] = {this->crossover_size, this->cpu_flops, this->gpu_step_time};
+	}
+	return;
+}
+
+
+
+
+
+bool GPUGramSchmidt::uses_routing(void) const
+{
+	return (this->backend == GPUGramSchmidt::Backend::automatic) || (this->backend == GPUGramSchmidt::Backend::hybrid);
+}
+
+
+
+
+
+size_t GPUGramSchmidt::get_crossover_size(void) const
+{
+	return this->crossover_size;
+}
+
+
+
+
+
+void GPUGramSchmidt::set_crossover_size(size_t const crossover_size)
+{
+	this->crossover_size = crossover_size;
+	return;
+}
+
+
+
+
+
+// Profiling
+
+
+
+
+
+void GPUGramSchmidt::set_gpu_timing(bool const enable)
+{
+	this->gpu_timing = enable;
+	return;
+}
+
+
+
+
+
+bool GPUGramSchmidt::get_gpu_timing(void) const
+{
+	return this->gpu_timing && this->vk_ready && (this->vk_timestamp_pool != VK_NULL_HANDLE);
+}
+
+
+
+
+
+GPUGramSchmidt::DeviceMemoryUsage GPUGramSchmidt::get_device_memory_usage(void) const
+{
+	GPUGramSchmidt::DeviceMemoryUsage usage;
+	if (!this->vk_ready)
+		return usage;
+	usage.matrix_buffer = this->vk_matrix_capacity;
+	if (!this->vk_memory_budget)
+		return usage;
+
+	// The driver estimates the usage of the whole process, heap by heap
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT vk_budget =
+	{
+		.sType      = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+		.pNext      = nullptr,
+		.heapBudget = {},
+		.heapUsage  = {}
+	};
+	VkPhysicalDeviceMemoryProperties2 vk_memory_properties =
+	{
+		.sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+		.pNext            = &vk_budget,
+		.memoryProperties = {}
+	};
+	vkGetPhysicalDeviceMemoryProperties2(this->vk_physical_device, &vk_memory_properties);
+	for (uint32_t heap_i = 0; heap_i < vk_memory_properties.memoryProperties.memoryHeapCount; ++heap_i)
+	{
+		usage.heap_usage  += vk_budget.heapUsage[heap_i];
+		usage.heap_budget += vk_budget.heapBudget[heap_i];
+	}
+	return usage;
+}
+
+
+
+
+
+GPUGramSchmidt::RunStats GPUGramSchmidt::get_total_stats(void) const
+{
+	std::lock_guard<std::mutex> guard(this->total_stats_lock);
+	return this->total_stats;
+}
+
+
+
+
+
+void GPUGramSchmidt::reset_total_stats(void)
+{
+	std::lock_guard<std::mutex> guard(this->total_stats_lock);
+	this->total_stats = GPUGramSchmidt::RunStats();
+	return;
+}
+
+
+
+
+
+std::pair<uint32_t, double> GPUGramSchmidt::time_probe(uint32_t const mode, uint32_t const invocation_count)
+{
+	VkPipeline const              vk_probe_pipeline = this->get_probe_pipeline(mode);
+	GPUGramSchmidt::Variant const probe_variant{.workgroup_size = probe_workgroup_size};
+	uint32_t                      pass_count = 1;
+	auto const timed_run = [&](void)
+	{
+		auto const start_time = std::chrono::steady_clock::now();
+		this->submit_step(vk_probe_pipeline, probe_variant, pass_count, invocation_count, 0, nullptr);
+		this->wait_step(nullptr);
+		return seconds_since(start_time);
+	};
+
+	// 1. Double the number of passes until a run is long enough for the host clock (the first
+	//    run also warms the pipeline up)
+	double run_time = timed_run();
+	while ((run_time < 1.0e-2) && (pass_count < (1U << 20)))
+	{
+		pass_count *= 2;
+		run_time = timed_run();
+	}
+
+	// 2. Keep the best of a few runs
+	for (uint32_t run_i = 0; run_i < 3; ++run_i)
+		run_time = std::min(run_time, timed_run());
+	return std::make_pair(pass_count, run_time);
+}
+
+
+
+
+
+GPUGramSchmidt::DeviceLimits GPUGramSchmidt::measure_device_limits(void)
+{
+	if (!this->await_gpu())
+		throw std::runtime_error("Device limits cannot be measured: the GPU is not set up.");
+	GPUGramSchmidt::DeviceLimits limits;
+
+	// 1. Arithmetic: enough invocations to fill any GPU, 16 operations per invocation and pass
+	uint32_t const arithmetic_invocation_count = static_cast<uint32_t>(std::min<uint64_t>(1U << 20, uint64_t(this->vk_physical_device_properties.limits.maxComputeWorkGroupCount[0]) * probe_workgroup_size));
+	this->reserve_matrix_memory(arithmetic_invocation_count * 8ULL);
+	auto const arithmetic = this->time_probe(probe_arithmetic, arithmetic_invocation_count);
+	limits.fp64_flops = 16.0 * arithmetic_invocation_count * arithmetic.first / arithmetic.second;
+
+	// 2. Memory: two halves of 32 MiB, far more than the caches hold; each pass reads one half
+	//    and writes the other
+	uint32_t const memory_invocation_count = static_cast<uint32_t>(std::min<uint64_t>(1U << 22, uint64_t(this->vk_physical_device_properties.limits.maxComputeWorkGroupCount[0]) * probe_workgroup_size));
+	this->reserve_matrix_memory(memory_invocation_count * 16ULL);
+	auto const memory = this->time_probe(probe_memory, memory_invocation_count);
+	limits.bandwidth = 16.0 * memory_invocation_count * memory.first / memory.second;
+
+	return limits;
+}
+
+
+
+
+
+void GPUGramSchmidt::record(GPUGramSchmidt::RunStats const &call_stats)
+{
+	std::lock_guard<std::mutex> guard(this->total_stats_lock);
+	GPUGramSchmidt::RunStats &total = this->total_stats;
+	total.call_count       += call_stats.call_count;
+	total.matrix_count     += call_stats.matrix_count;
+	total.allocation_time  += call_stats.allocation_time;
+	total.upload_time      += call_stats.upload_time;
+	total.compute_time     += call_stats.compute_time;
+	total.download_time    += call_stats.download_time;
+	total.gpu_compute_time += call_stats.gpu_compute_time;
+	total.fence_wait_time  += call_stats.fence_wait_time;
+	total.bytes_uploaded   += call_stats.bytes_uploaded;
+	total.bytes_downloaded += call_stats.bytes_downloaded;
+	total.allocation_count += call_stats.allocation_count;
+	total.submit_count     += call_stats.submit_count;
+	total.dispatch_count   += call_stats.dispatch_count;
+	// These cannot be summed; the totals keep the ones of the last call
+	total.backend     = call_stats.backend;
+	total.memory_type = call_stats.memory_type;
+	total.variant     = call_stats.variant;
+	return;
+}
+
+
+
+
+
+// Kernel variants & device memory
+
+
+
+
+
+void GPUGramSchmidt::set_variant(GPUGramSchmidt::Variant const &variant)
+{
+	if (this->await_gpu())
+		this->get_compute_pipeline(variant);
+	this->variant = variant;
+	return;
+}
+
+
+
+
+
+GPUGramSchmidt::Variant GPUGramSchmidt::get_variant(void) const
+{
+	return this->variant;
+}
+
+
+
+
+
+std::vector<GPUGramSchmidt::PipelineExecutable> GPUGramSchmidt::get_pipeline_statistics(GPUGramSchmidt::Variant const &variant)
+{
+	if (!this->await_gpu())
+		throw std::runtime_error("Pipeline statistics cannot be read: the GPU is not set up.");
+	std::vector<GPUGramSchmidt::PipelineExecutable> executables;
+	if ((this->vk_get_executable_properties == nullptr) || (this->vk_get_executable_statistics == nullptr))
+		return executables;
+
+	// 1. Compile the variant once more, this time keeping the statistics; a pipeline created
+	//    without the flag cannot be queried
+	VkPipeline const vk_pipeline = this->create_compute_pipeline(variant, VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR);
+	try
+	{
+		// 2. Enumerate the executables the driver made of the pipeline (usually just one)
+		VkPipelineInfoKHR const vk_pipeline_info =
+		{
+			.sType    = VK_STRUCTURE_TYPE_PIPELINE_INFO_KHR,
+			.pNext    = nullptr,
+			.pipeline = vk_pipeline
+		};
+		uint32_t vk_executable_count = 0;
+		VK_VALIDATE(  this->vk_get_executable_properties(this->vk_device, &vk_pipeline_info, &vk_executable_count, nullptr), "Pipeline executables enumeration failed."  );
+		std::vector<VkPipelineExecutablePropertiesKHR> vk_executables(vk_executable_count, {.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_PROPERTIES_KHR, .pNext = nullptr, .stages = 0, .name = {}, .description = {}, .subgroupSize = 0});
+		VK_VALIDATE(  this->vk_get_executable_properties(this->vk_device, &vk_pipeline_info, &vk_executable_count, vk_executables.data()), "Pipeline executables enumeration failed."  );
+
+		// 3. Read the statistics of each one
+		for (uint32_t executable_i = 0; executable_i < vk_executable_count; ++executable_i)
+		{
+			GPUGramSchmidt::PipelineExecutable executable;
+			executable.name          = vk_executables[executable_i].name;
+			executable.description   = vk_executables[executable_i].description;
+			executable.subgroup_size = vk_executables[executable_i].subgroupSize;
+			VkPipelineExecutableInfoKHR const vk_executable_info =
+			{
+				.sType           = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INFO_KHR,
+				.pNext           = nullptr,
+				.pipeline        = vk_pipeline,
+				.executableIndex = executable_i
+			};
+			uint32_t vk_statistic_count = 0;
+			VK_VALIDATE(  this->vk_get_executable_statistics(this->vk_device, &vk_executable_info, &vk_statistic_count, nullptr), "Pipeline statistics reading failed."  );
+			std::vector<VkPipelineExecutableStatisticKHR> vk_statistics(vk_statistic_count, {.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_STATISTIC_KHR, .pNext = nullptr, .name = {}, .description = {}, .format = VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR, .value = {}});
+			VK_VALIDATE(  this->vk_get_executable_statistics(this->vk_device, &vk_executable_info, &vk_statistic_count, vk_statistics.data()), "Pipeline statistics reading failed."  );
+			for (VkPipelineExecutableStatisticKHR const &vk_statistic : vk_statistics)
+			{
+				double value = 0.0;
+				switch (vk_statistic.format)
+				{
+					case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_BOOL32_KHR:  value = (vk_statistic.value.b32 == VK_TRUE) ? (1.0) : (0.0); break;
+					case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_INT64_KHR:   value = static_cast<double>(vk_statistic.value.i64);       break;
+					case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR:  value = static_cast<double>(vk_statistic.value.u64);       break;
+					case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_FLOAT64_KHR: value = vk_statistic.value.f64;                            break;
+					default: break;
+				}
+				executable.statistics.push_back(GPUGramSchmidt::PipelineStatistic{vk_statistic.name, vk_statistic.description, value});
+			}
+			executables.push_back(executable);
+		}
+	}
+	catch (std::exception const &)
+	{
+		vkDestroyPipeline(this->vk_device, vk_pipeline, nullptr);
+		throw;
+	}
+	vkDestroyPipeline(this->vk_device, vk_pipeline, nullptr);
+	return executables;
+}
+
+
+
+
+
+VkPipeline GPUGramSchmidt::create_compute_pipeline(GPUGramSchmidt::Variant const &variant, VkPipelineCreateFlags const vk_flags)
+{
+	// 1. Check that the device is able to run a work group of the requested size
+	if ((variant.workgroup_size == 0) ||
+	    (variant.workgroup_size > this->vk_physical_device_properties.limits.maxComputeWorkGroupSize[0]) ||
+	    (variant.workgroup_size > this->vk_physical_device_properties.limits.maxComputeWorkGroupInvocations))
+		throw std::runtime_error("Work group size " + std::to_string(variant.workgroup_size) + " is not supported by your GPU.");
+
+	// 2. Specialise the work group size (constant_id = 0)
+	VkSpecializationMapEntry const vk_workgroup_size_entry =
+	{
+		.constantID = 0,
+		.offset     = 0,
+		.size       = sizeof(uint32_t)
+	};
+	VkSpecializationInfo const vk_specialization_info =
+	{
+		.mapEntryCount = 1,
+		.pMapEntries   = &vk_workgroup_size_entry,
+		.dataSize      = sizeof(uint32_t),
+		.pData         = &variant.workgroup_size
+	};
+
+	// 3. Create the pipeline itself
+	VkPipelineShaderStageCreateInfo const vk_shader_stage_info =
+	{
+		.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+		.pNext               = nullptr,
+		.flags               = 0,
+		.stage               = VK_SHADER_STAGE_COMPUTE_BIT,
+		.module              = this->vk_compute_shader,
+		.pName               = "main",
+		.pSpecializationInfo = &vk_specialization_info
+	};
+	VkComputePipelineCreateInfo const vk_compute_pipeline_info =
+	{
+		.sType              = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext              = nullptr,
+		.flags              = vk_flags,
+		.stage              = vk_shader_stage_info,
+		.layout             = this->vk_compute_pipeline_layout,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex  = -1
+	};
+	VkPipeline vk_compute_pipeline;
+	VK_VALIDATE(  vkCreateComputePipelines(this->vk_device, VK_NULL_HANDLE, 1, &vk_compute_pipeline_info, nullptr, &vk_compute_pipeline), "Compute pipeline creation failed."  );
+
+	return vk_compute_pipeline;
+}
+
+
+
+
+
+VkPipeline GPUGramSchmidt::get_compute_pipeline(GPUGramSchmidt::Variant const &variant)
+{
+	auto vk_compute_pipeline = this->vk_compute_pipelines.find(variant.workgroup_size);
+	if (vk_compute_pipeline != this->vk_compute_pipelines.end())
+		return vk_compute_pipeline->second;
+	return this->vk_compute_pipelines[variant.workgroup_size] = this->create_compute_pipeline(variant);
+}
+
+
+
+
+
+VkShaderModule GPUGramSchmidt::load_shader(std::string const &file_name)
+{
+	std::fstream shader_loader(GPUGramSchmidt::shader_folder + "/" + file_name, std::ios_base::binary | std::ios_base::in | std::ios_base::ate);
+	if (shader_loader.fail())
+		throw std::runtime_error("File '" + GPUGramSchmidt::shader_folder + "/" + file_name + "' was not found.");
+	size_t shader_byte_count = shader_loader.tellg();
+	shader_loader.seekg(0, shader_loader.beg);
+	std::vector<char> shader_bytes(shader_byte_count + (4 - shader_byte_count % 4) % 4, 0);
+	shader_loader.read(shader_bytes.data(), shader_byte_count);
+	shader_loader.close();
+	VkShaderModuleCreateInfo const vk_shader_info =
+	{
+		.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.pNext    = nullptr,
+		.flags    = 0, // reserved
+		.codeSize = shader_bytes.size(),
+		.pCode    = reinterpret_cast<uint32_t const *>(shader_bytes.data())
+	};
+	VkShaderModule vk_shader;
+	VK_VALIDATE(  vkCreateShaderModule(this->vk_device, &vk_shader_info, nullptr, &vk_shader), "Compute shader module '" + file_name + "' creation failed."  );
+	return vk_shader;
+}
+
+
+
+
+
+VkPipeline GPUGramSchmidt::create_specialised_pipeline(VkShaderModule const vk_shader, uint32_t const constant_1)
+{
+	// 1. Specialise constant_id = 1; the work group size keeps its default
+	VkSpecializationMapEntry const vk_constant_entry =
+	{
+		.constantID = 1,
+		.offset     = 0,
+		.size       = sizeof(uint32_t)
+	};
+	VkSpecializationInfo const vk_specialization_info =
+	{
+		.mapEntryCount = 1,
+		.pMapEntries   = &vk_constant_entry,
+		.dataSize      = sizeof(uint32_t),
+		.pData         = &constant_1
+	};
+
+	// 2. Create the pipeline itself
+	VkPipelineShaderStageCreateInfo const vk_shader_stage_info =
+	{
+		.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+		.pNext               = nullptr,
+		.flags               = 0,
+		.stage               = VK_SHADER_STAGE_COMPUTE_BIT,
+		.module              = vk_shader,
+		.pName               = "main",
+		.pSpecializationInfo = &vk_specialization_info
+	};
+	VkComputePipelineCreateInfo const vk_pipeline_info =
+	{
+		.sType              = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext              = nullptr,
+		.flags              = 0,
+		.stage              = vk_shader_stage_info,
+		.layout             = this->vk_compute_pipeline_layout,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex  = -1
+	};
+	VkPipeline vk_pipeline;
+	VK_VALIDATE(  vkCreateComputePipelines(this->vk_device, VK_NULL_HANDLE, 1, &vk_pipeline_info, nullptr, &vk_pipeline), "Specialised compute pipeline creation failed."  );
+	return vk_pipeline;
+}
+
+
+
+
+
+VkPipeline GPUGramSchmidt::get_fixed_pipeline(uint32_t const dim)
+{
+	auto vk_fixed_pipeline = this->vk_fixed_pipelines.find(dim);
+	if (vk_fixed_pipeline != this->vk_fixed_pipelines.end())
+		return vk_fixed_pipeline->second;
+
+	// The shader is loaded on the first use, and the matrix order is its constant_id = 1
+	if (this->vk_fixed_shader == VK_NULL_HANDLE)
+		this->vk_fixed_shader = this->load_shader("vulkan-gram-schmidt-fixed.spv");
+	return this->vk_fixed_pipelines[dim] = this->create_specialised_pipeline(this->vk_fixed_shader, dim);
+}
+
+
+
+
+
+bool GPUGramSchmidt::has_fixed_pipeline(uint32_t const dim)
+{
+	if (this->vk_fixed_missing)
+		return false;
+	try
+	{
+		this->get_fixed_pipeline(dim);
+	}
+	catch (std::exception const &)
+	{
+		this->vk_fixed_missing = (this->vk_fixed_shader == VK_NULL_HANDLE);
+		return false;
+	}
+	return true;
+}
+
+
+
+
+
+VkPipeline GPUGramSchmidt::get_probe_pipeline(uint32_t const mode)
+{
+	auto vk_probe_pipeline = this->vk_probe_pipelines.find(mode);
+	if (vk_probe_pipeline != this->vk_probe_pipelines.end())
+		return vk_probe_pipeline->second;
+
+	// The shader is loaded on the first use, and the mode is its constant_id = 1
+	if (this->vk_probe_shader == VK_NULL_HANDLE)
+		this->vk_probe_shader = this->load_shader("vulkan-gram-schmidt-probe.spv");
+	return this->vk_probe_pipelines[mode] = this->create_specialised_pipeline(this->vk_probe_shader, mode);
+}
+
+
+
+
+
+void GPUGramSchmidt::reserve_matrix_memory(VkDeviceSize const byte_count, GPUGramSchmidt::RunStats *const stats)
+{
+	if (byte_count <= this->vk_matrix_capacity)
+		return;
+
+	// 1. Release the previous buffer, it is too small
+	vkDestroyBuffer(this->vk_device, this->vk_matrix_buffer, nullptr);
+	vkFreeMemory(this->vk_device, this->vk_matrix_memory, nullptr);
+	this->vk_matrix_buffer      = VK_NULL_HANDLE;
+	this->vk_matrix_memory      = VK_NULL_HANDLE;
+	this->vk_matrix_capacity    = 0;
+	this->vk_matrix_memory_type = -1;
+
+	// 2. Create buffer for the matrix
+	//   2.1. Create handle for the storage buffer
+	VkBufferCreateInfo const vk_matrix_buffer_info =
+	{
+		.sType                 = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.pNext                 = nullptr,
+		.flags                 = 0,
+		.size                  = byte_count,
+		.usage                 = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		.sharingMode           = VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = 1,
+		.pQueueFamilyIndices   = &this->vk_selected_queue_family_i // ignored due to VK_SHARING_MODE_EXCLUSIVE
+	};
+	VK_VALIDATE(  vkCreateBuffer(this->vk_device, &vk_matrix_buffer_info, nullptr, &this->vk_matrix_buffer), "Matrix buffer creation failed."  );
+	//   2.2. Get the device memory requirements for the buffer
+	VkMemoryRequirements vk_matrix_buffer_memory_reqs;
+	vkGetBufferMemoryRequirements(this->vk_device, this->vk_matrix_buffer, &vk_matrix_buffer_memory_reqs);
+
+	// 3. Allocate device memory for computations
+	//   3.1. Find a suitable memory type
+	VkPhysicalDeviceMemoryProperties vk_device_memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(this->vk_physical_device, &vk_device_memory_properties);
+	//   3.2. Try to find memory type with needed properties and enough free space
+	bool allocation_success = false;
+	for (uint32_t memory_type_i = 0; memory_type_i < vk_device_memory_properties.memoryTypeCount; ++memory_type_i)
+	{
+		if (((vk_device_memory_properties.memoryTypes[memory_type_i].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0) ||
+		    ((vk_device_memory_properties.memoryTypes[memory_type_i].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) ||
+		    ((vk_device_memory_properties.memoryTypes[memory_type_i].propertyFlags & vk_matrix_buffer_memory_reqs.memoryTypeBits) == 0) ||
+		    (vk_device_memory_properties.memoryHeaps[vk_device_memory_properties.memoryTypes[memory_type_i].heapIndex].size < vk_matrix_buffer_memory_reqs.size))
+			continue;
+		VkMemoryAllocateInfo const vk_memory_info =
+		{
+			.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.pNext           = nullptr,
+			.allocationSize  = vk_matrix_buffer_memory_reqs.size,
+			.memoryTypeIndex = memory_type_i
+		};
+		if (vkAllocateMemory(this->vk_device, &vk_memory_info, nullptr, &this->vk_matrix_memory) == VK_SUCCESS)
+		{
+			this->vk_matrix_memory_type = static_cast<int32_t>(memory_type_i);
+			allocation_success = true;
+			break;
+		}
+	}
+	if (allocation_success == false)
+		throw std::runtime_error("Unable to allocate memory on your GPU.");
+	vgs::metrics_add_allocation();
+	if (stats != nullptr)
+		++stats->allocation_count;
+	
+	// 4. Bind memory with the buffer
+	VK_VALIDATE(  vkBindBufferMemory(this->vk_device, this->vk_matrix_buffer, this->vk_matrix_memory, 0), "Device memory association with the matrix buffer failed."  );
+	this->vk_matrix_capacity = byte_count;
+
+	// 5. Associate the buffer with the descriptor set binding
+	VkDescriptorBufferInfo const vk_matrix_buffer_descriptor_info =
+	{
+		.buffer = this->vk_matrix_buffer,
+		.offset = 0,
+		.range  = VK_WHOLE_SIZE
+	};
+	VkWriteDescriptorSet const vk_write_descriptor_set_0 =
+	{
+		.sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.pNext            = nullptr,
+		.dstSet           = this->vk_descriptor_set_0,
+		.dstBinding       = 0,
+		.dstArrayElement  = 0,
+		.descriptorCount  = 1,
+		.descriptorType   = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.pImageInfo       = nullptr,
+		.pBufferInfo      = &vk_matrix_buffer_descriptor_info,
+		.pTexelBufferView = nullptr
+	};
+	vkUpdateDescriptorSets(this->vk_device, 1, &vk_write_descriptor_set_0, 0, nullptr);
+
+	return;
+}
+
+
+
+
+
+// Computations
+
+
+
+
+
+void GPUGramSchmidt::submit_step(VkPipeline const vk_compute_pipeline, GPUGramSchmidt::Variant const &variant, uint32_t const dim, uint32_t const vector_count, uint32_t const start_vec_i, GPUGramSchmidt::RunStats *const stats)
+{
+	// 1. Start buffer recording
 	VkCommandBufferBeginInfo const vk_command_buffer_begin_info =
 	{
 		.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -471,36 +1536,510 @@ void GPUGramSchmidt::run(GPUGramSchmidt::Matrix &matrix, bool const vectors_as_c
 		.signalSemaphoreCount = 0,
 		.pSignalSemaphores    = nullptr
 	};
-	uint32_t push_constants[] = {(uint32_t)matrix.size(), (uint32_t)matrix.size(), 0};
-	for (uint32_t start_vec_i = 0; start_vec_i < matrix.size(); ++start_vec_i)
+	uint32_t const push_constants[] = {dim, vector_count, start_vec_i};
+	this->vk_step_timed = (this->vk_timestamp_pool != VK_NULL_HANDLE) && ((vgs::trace_enabled) || ((stats != nullptr) && (this->gpu_timing)));
 	{
-		VK_VALIDATE(  vkBeginCommandBuffer(this->vk_command_buffer, &vk_command_buffer_begin_info), "Command buffer recording failed to start.", false  );
-		//   6.2. Bind the compute pipeline with the buffer
-		vkCmdBindPipeline(this->vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->vk_compute_pipeline);
-		//   6.3. Bind the descriptor set with the buffer
+		VGS_TRACE_ZONE("record");
+		VK_VALIDATE(  vkBeginCommandBuffer(this->vk_command_buffer, &vk_command_buffer_begin_info), "Command buffer recording failed to start."  );
+		// 2. Bind the compute pipeline with the buffer
+		vkCmdBindPipeline(this->vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, vk_compute_pipeline);
+		// 3. Bind the descriptor set with the buffer
 		vkCmdBindDescriptorSets(this->vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->vk_compute_pipeline_layout, 0, 1, &this->vk_descriptor_set_0, 0, nullptr);
-		//   6.4. Push constants
-		push_constants[2] = start_vec_i;
+		// 4. Push constants and dispatch, between two timestamps if the step is timed
 		vkCmdPushConstants(this->vk_command_buffer, this->vk_compute_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, 4 * 3, push_constants);
-		vkCmdDispatch(this->vk_command_buffer, (matrix.size() - start_vec_i) / 32 + ((matrix.size() - start_vec_i) % 32 > 0), 1, 1);
-		//   6.5. Finish buffer recording
-		VK_VALIDATE(  vkEndCommandBuffer(this->vk_command_buffer), "Command buffer recording failed to end.", false  );
-		//   6.6. Submit the command buffer to the GPU queue
-		VK_VALIDATE(  vkQueueSubmit(this->vk_queues[0], 1, &vk_submit_info, this->vk_fence), "Queue submission failed.", false  );
-		//   6.7. Wait for the fence before continuing execution
-		VK_VALIDATE(  vkWaitForFences(this->vk_device, 1, &this->vk_fence, VK_TRUE, 10000000), "Waiting for the fence failed.", false  );
-		VK_VALIDATE(  vkResetFences(this->vk_device, 1, &this->vk_fence), "Fence reset failed.", false  );
-	}
-
-	// 7. Read the result into the original matrix
-	VK_VALIDATE(  vkMapMemory(this->vk_device, vk_matrix_memory, 0, matrix.size() * matrix.size() * 8, 0, reinterpret_cast<void **>(&payload)), "Memory mapping after calculations failed.", false  );
-	for (uint32_t i = 0; i < matrix.size(); ++i)
-		for (uint32_t j = 0; j < matrix.size(); ++j)
-			matrix[vectors_as_columns ? j : i][vectors_as_columns? i : j] = payload[i * matrix.size() + j];
-	vkUnmapMemory(this->vk_device, vk_matrix_memory);
-
-	vkDestroyBuffer(this->vk_device, vk_matrix_buffer, nullptr);
-	vkFreeMemory(this->vk_device, vk_matrix_memory, nullptr);
+		if (this->vk_step_timed)
+		{
+			vkCmdResetQueryPool(this->vk_command_buffer, this->vk_timestamp_pool, 0, 2);
+			vkCmdWriteTimestamp(this->vk_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, this->vk_timestamp_pool, 0);
+		}
+		vkCmdDispatch(this->vk_command_buffer, (vector_count - start_vec_i) / variant.workgroup_size + ((vector_count - start_vec_i) % variant.workgroup_size > 0), 1, 1);
+		if (this->vk_step_timed)
+			vkCmdWriteTimestamp(this->vk_command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, this->vk_timestamp_pool, 1);
+		// 5. Finish buffer recording
+		VK_VALIDATE(  vkEndCommandBuffer(this->vk_command_buffer), "Command buffer recording failed to end."  );
+	}
+	// 6. Submit the command buffer to the GPU queue
+	{
+		VGS_TRACE_ZONE("submit");
+		VK_VALIDATE(  vkQueueSubmit(this->vk_queues[0], 1, &vk_submit_info, this->vk_fence), "Queue submission failed."  );
+	}
+	if (stats != nullptr)
+	{
+		++stats->submit_count;
+		++stats->dispatch_count;
+	}
+	return;
+}
+
+
+
+
+
+void GPUGramSchmidt::on_gpu_node(size_t const row_count, std::function<void(size_t, size_t)> const &body)
+{
+	if (this->numa_pool == nullptr)
+	{
+		body(0, row_count);
+		return;
+	}
+	size_t const worker_count = this->numa_pool->size() - 1;
+	this->numa_pool->parallel_for_on_workers(0, row_count, (row_count + worker_count - 1) / worker_count, body);
+	return;
+}
+
+
+
+
+
+void GPUGramSchmidt::wait_step(GPUGramSchmidt::RunStats *const stats)
+{
+	// A single dispatch over a large batch may take longer than one wait; that is not an error
+	// unless the whole step exceeds GPUGramSchmidt::step_timeout. The fence is then still pending,
+	// so the GPU must not be used any more
+	auto const wait_start_time = std::chrono::steady_clock::now();
+	auto const wait_deadline   = wait_start_time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(GPUGramSchmidt::step_timeout));
+	VkResult   vk_wait_result  = VK_TIMEOUT;
+	while (vk_wait_result == VK_TIMEOUT)
+	{
+		vk_wait_result = vkWaitForFences(this->vk_device, 1, &this->vk_fence, VK_TRUE, 10000000);
+		if (vk_wait_result != VK_TIMEOUT)
+			break;
+		if (std::chrono::steady_clock::now() >= wait_deadline)
+		{
+			vgs::metrics_add_step_timeout();
+			this->vk_ready = false;
+			throw std::runtime_error("The GPU has not finished a step in " + std::to_string(GPUGramSchmidt::step_timeout) + " seconds; it will not be used any more.");
+		}
+	}
+	VGS_TRACE_HOST("wait", wait_start_time);
+	VK_VALIDATE(  vk_wait_result, "Waiting for the fence failed."  );
+	VK_VALIDATE(  vkResetFences(this->vk_device, 1, &this->vk_fence), "Fence reset failed."  );
+	double const fence_wait_time = seconds_since(wait_start_time);
+	if (stats != nullptr)
+		stats->fence_wait_time += fence_wait_time;
+	// Without timestamps, the wait is the best estimate of the time the GPU was busy
+	if (!this->vk_step_timed)
+	{
+		vgs::metrics_add_gpu_busy_time(fence_wait_time);
+		return;
+	}
+
+	// The step is over, so the timestamps are available; timestampPeriod is in nanoseconds per tick
+	uint64_t vk_timestamps[2] = {0, 0};
+	VK_VALIDATE(  vkGetQueryPoolResults(this->vk_device, this->vk_timestamp_pool, 0, 2, sizeof(vk_timestamps), vk_timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT), "Reading of the GPU timestamps failed."  );
+	double const tick_period = this->vk_physical_device_properties.limits.timestampPeriod;
+	uint64_t const tick_count = (vk_timestamps[1] - vk_timestamps[0]) & this->vk_timestamp_mask;
+	vgs::metrics_add_gpu_busy_time(tick_count * tick_period * 1.0e-9);
+	if ((stats != nullptr) && (this->gpu_timing))
+		stats->gpu_compute_time += tick_count * tick_period * 1.0e-9;
+#ifdef VGS_ENABLE_TRACING
+	// Put the step on the host clock: exactly, if the driver correlates the clocks; otherwise, as
+	// if it ended right now (which is an upper bound)
+	int64_t end_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	if (this->vk_get_calibrated_timestamps != nullptr)
+	{
+		VkCalibratedTimestampInfoEXT const vk_time_domains[2] =
+		{
+			{.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, .pNext = nullptr, .timeDomain = VK_TIME_DOMAIN_DEVICE_EXT},
+			{.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, .pNext = nullptr, .timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT}
+		};
+		uint64_t vk_now[2]        = {0, 0};
+		uint64_t vk_max_deviation = 0;
+		if (this->vk_get_calibrated_timestamps(this->vk_device, 2, vk_time_domains, vk_now, &vk_max_deviation) == VK_SUCCESS)
+			end_ns = static_cast<int64_t>(vk_now[1]) - static_cast<int64_t>(((vk_now[0] - vk_timestamps[1]) & this->vk_timestamp_mask) * tick_period);
+	}
+	vgs::trace_gpu_range("dispatch", this->trace_track, end_ns - static_cast<int64_t>(tick_count * tick_period), end_ns);
+#endif // VGS_ENABLE_TRACING
+	return;
+}
+
+
+
+
+
+void GPUGramSchmidt::run(GPUGramSchmidt::Matrix &matrix, bool const vectors_as_columns, GPUGramSchmidt::RunStats *const stats)
+{
+	// Statistics are always collected for the totals; the caller may also want them
+	vgs::CallMetrics const   call_metrics;
+	GPUGramSchmidt::RunStats call_stats;
+	call_stats.call_count = 1;
+
+	// 0. Use the CPU if there is no GPU, if it is not set up yet or if the matrix is too small
+	//    to pay off the GPU overhead (unless the GPU was requested explicitly, in which case wait
+	//    for it)
+	if ((this->backend != GPUGramSchmidt::Backend::gpu) && ((!this->vk_ready) || (matrix.size() < this->crossover_size)))
+	{
+		if ((this->backend != GPUGramSchmidt::Backend::cpu) && (!this->vk_ready))
+			vgs::metrics_add_cpu_fallback();
+		auto const compute_start_time = std::chrono::steady_clock::now();
+		this->cpu_solver->run(matrix, vectors_as_columns);
+		VGS_TRACE_HOST("cpu", compute_start_time);
+		call_stats.compute_time = seconds_since(compute_start_time);
+		add_matrices(call_stats, GPUGramSchmidt::Backend::cpu, 1);
+	}
+	else
+	{
+		this->wait_until_ready();
+		if (this->backend == GPUGramSchmidt::Backend::hybrid)
+			this->run_hybrid(matrix, vectors_as_columns, &call_stats);
+		else
+			this->run_variant(matrix, vectors_as_columns, this->variant, &call_stats);
+	}
+
+	this->record(call_stats);
+	if (stats != nullptr)
+		*stats = call_stats;
+	return;
+}
+
+
+
+
+
+void GPUGramSchmidt::run_variant(GPUGramSchmidt::Matrix &matrix, bool const vectors_as_columns, GPUGramSchmidt::Variant const &variant, GPUGramSchmidt::RunStats *const stats)
+{
+	if (matrix.empty())
+		return;
+	auto phase_start_time = std::chrono::steady_clock::now();
+
+	// 1. Make sure the pipeline and the memory are there
+	VkPipeline const vk_compute_pipeline = this->get_compute_pipeline(variant);
+	this->reserve_matrix_memory(matrix.size() * matrix.size() * 8, stats);
+	double const allocation_time = seconds_since(phase_start_time);
+	VGS_TRACE_HOST("allocate", phase_start_time);
+	phase_start_time = std::chrono::steady_clock::now();
+
+	// 2. Fill the buffer with the matrix data on the NUMA node of the GPU
+	double *payload = nullptr;
+	VK_VALIDATE(  vkMapMemory(this->vk_device, this->vk_matrix_memory, 0, matrix.size() * matrix.size() * 8, 0, reinterpret_cast<void **>(&payload)), "Memory mapping before calculations failed."  );
+	this->on_gpu_node(matrix.size(), [&](size_t const row_begin, size_t const row_end)
+	{
+		for (size_t i = row_begin; i < row_end; ++i)
+			for (size_t j = 0; j < matrix.size(); ++j)
+				payload[i * matrix.size() + j] = vectors_as_columns ? matrix[j][i] : matrix[i][j];
+	});
+	vkUnmapMemory(this->vk_device, this->vk_matrix_memory);
+	double const upload_time = seconds_since(phase_start_time);
+	VGS_TRACE_HOST("pack", phase_start_time);
+	phase_start_time = std::chrono::steady_clock::now();
+
+	// 3. Submit one step of the process for each vector and wait for it
+	for (uint32_t start_vec_i = 0; start_vec_i < matrix.size(); ++start_vec_i)
+	{
+		this->submit_step(vk_compute_pipeline, variant, matrix.size(), matrix.size(), start_vec_i, stats);
+		this->wait_step(stats);
+	}
+	double const compute_time = seconds_since(phase_start_time);
+	VGS_TRACE_HOST("compute", phase_start_time);
+	phase_start_time = std::chrono::steady_clock::now();
+
+	// 4. Read the result into the original matrix
+	VK_VALIDATE(  vkMapMemory(this->vk_device, this->vk_matrix_memory, 0, matrix.size() * matrix.size() * 8, 0, reinterpret_cast<void **>(&payload)), "Memory mapping after calculations failed."  );
+	this->on_gpu_node(matrix.size(), [&](size_t const row_begin, size_t const row_end)
+	{
+		for (size_t i = row_begin; i < row_end; ++i)
+			for (size_t j = 0; j < matrix.size(); ++j)
+				matrix[vectors_as_columns ? j : i][vectors_as_columns? i : j] = payload[i * matrix.size() + j];
+	});
+	vkUnmapMemory(this->vk_device, this->vk_matrix_memory);
+	VGS_TRACE_HOST("unpack", phase_start_time);
+
+	if (stats != nullptr)
+	{
+		add_gpu_phases(*stats, allocation_time, upload_time, compute_time, seconds_since(phase_start_time), matrix.size() * matrix.size() * 8);
+		add_matrices(*stats, GPUGramSchmidt::Backend::gpu, 1);
+		stats->memory_type = this->vk_matrix_memory_type;
+		stats->variant     = variant;
+	}
+	
+	return;
+}
+
+
+
+
+
+void GPUGramSchmidt::run_hybrid(GPUGramSchmidt::Matrix &matrix, bool const vectors_as_columns, GPUGramSchmidt::RunStats *const stats)
+{
+	// The vectors are processed in segments. Within a segment [begin, n), the GPU runs the usual
+	// steps on the leading vectors [begin, split) only, while the CPU cleans the trailing vectors
+	// [split, n) of the components along each leading vector as soon as the GPU has finished it.
+	// The next segment starts at split. The split is chosen so that the CPU work per step takes
+	// as long as a GPU step, and the rates are refined after each segment.
+	size_t const n = matrix.size();
+	if (n == 0)
+		return;
+	using Clock = std::chrono::steady_clock;
+	auto phase_start_time = Clock::now();
+
+	// 1. Make sure the pipeline and the memory are there
+	VkPipeline const vk_compute_pipeline = this->get_compute_pipeline(this->variant);
+	this->reserve_matrix_memory(n * n * 8, stats);
+	double const allocation_time = seconds_since(phase_start_time);
+	VGS_TRACE_HOST("allocate", phase_start_time);
+	phase_start_time = Clock::now();
+
+	// 2. Fill the buffer with the matrix data on the NUMA node of the GPU; it stays mapped, as both
+	//    devices work on it
+	double *payload = nullptr;
+	VK_VALIDATE(  vkMapMemory(this->vk_device, this->vk_matrix_memory, 0, n * n * 8, 0, reinterpret_cast<void **>(&payload)), "Memory mapping before calculations failed."  );
+	this->on_gpu_node(n, [&](size_t const row_begin, size_t const row_end)
+	{
+		for (size_t i = row_begin; i < row_end; ++i)
+			for (size_t j = 0; j < n; ++j)
+				payload[i * n + j] = vectors_as_columns ? matrix[j][i] : matrix[i][j];
+	});
+	double const upload_time = seconds_since(phase_start_time);
+	VGS_TRACE_HOST("pack", phase_start_time);
+	phase_start_time = Clock::now();
+
+	// 3. Process segments
+	for (size_t begin = 0; begin < n; )
+	{
+		size_t const remaining_count = n - begin;
+		//   3.1. The tail that is too small for the GPU is finished on CPU
+		if (remaining_count < std::max(this->crossover_size.load(), size_t(2)))
+		{
+			this->cpu_solver->orthonormalise(payload + begin * n, remaining_count, n);
+			break;
+		}
+		//   3.2. Choose the split: the CPU does as many vectors as it can clean during one GPU step
+		//        (a projection takes 4n flops)
+		size_t const cpu_count = std::min(static_cast<size_t>(this->gpu_step_time * this->cpu_flops / (4.0 * n)), remaining_count - 1);
+		size_t const split     = n - cpu_count;
+		//   3.3. Run GPU steps on the leading vectors, let the CPU catch up between submission and
+		//        waiting
+		double cpu_time  = 0.0;
+		double wait_time = 0.0;
+		size_t applied_i = begin;
+		for (size_t start_vec_i = begin; start_vec_i < split; ++start_vec_i)
+		{
+			this->submit_step(vk_compute_pipeline, this->variant, n, split, start_vec_i, stats);
+			auto const cpu_start_time = Clock::now();
+			this->cpu_solver->project_out(payload + applied_i * n, start_vec_i - applied_i, payload + split * n, cpu_count, n);
+			applied_i = start_vec_i;
+			VGS_TRACE_HOST("project", cpu_start_time);
+			auto const wait_start_time = Clock::now();
+			this->wait_step(stats);
+			cpu_time  += std::chrono::duration<double>(wait_start_time - cpu_start_time).count();
+			wait_time += std::chrono::duration<double>(Clock::now() - wait_start_time).count();
+		}
+		auto const cpu_start_time = Clock::now();
+		this->cpu_solver->project_out(payload + applied_i * n, split - applied_i, payload + split * n, cpu_count, n);
+		VGS_TRACE_HOST("project", cpu_start_time);
+		cpu_time += std::chrono::duration<double>(Clock::now() - cpu_start_time).count();
+		//   3.4. Refine the rates. If the CPU had to wait, a GPU step took the CPU time plus the
+		//        waiting; otherwise the GPU was faster by an unknown margin, so shrink the CPU share
+		size_t const step_count = split - begin;
+		if ((cpu_count > 0) && (cpu_time > 0.0))
+			this->cpu_flops = 0.5 * this->cpu_flops + 0.5 * (4.0 * n * cpu_count * step_count / cpu_time);
+		double const gpu_step_estimate = (wait_time > 0.1 * cpu_time) ? ((cpu_time + wait_time) / step_count) : (0.75 * cpu_time / step_count);
+		if (gpu_step_estimate > 0.0)
+			this->gpu_step_time = 0.5 * this->gpu_step_time + 0.5 * gpu_step_estimate;
+		begin = split;
+	}
+	double const compute_time = seconds_since(phase_start_time);
+	VGS_TRACE_HOST("compute", phase_start_time);
+	phase_start_time = Clock::now();
+
+	// 4. Read the result into the original matrix
+	this->on_gpu_node(n, [&](size_t const row_begin, size_t const row_end)
+	{
+		for (size_t i = row_begin; i < row_end; ++i)
+			for (size_t j = 0; j < n; ++j)
+				matrix[vectors_as_columns ? j : i][vectors_as_columns ? i : j] = payload[i * n + j];
+	});
+	vkUnmapMemory(this->vk_device, this->vk_matrix_memory);
+	VGS_TRACE_HOST("unpack", phase_start_time);
+
+	if (stats != nullptr)
+	{
+		add_gpu_phases(*stats, allocation_time, upload_time, compute_time, seconds_since(phase_start_time), n * n * 8);
+		add_matrices(*stats, GPUGramSchmidt::Backend::hybrid, 1);
+		stats->memory_type = this->vk_matrix_memory_type;
+		stats->variant     = this->variant;
+	}
 	
 	return;
 }
+
+
+
+
+
+void GPUGramSchmidt::run_batch(std::vector<GPUGramSchmidt::Matrix> &matrices, bool const vectors_as_columns, GPUGramSchmidt::RunStats *const stats)
+{
+	// Statistics are always collected for the totals; the caller may also want them
+	vgs::CallMetrics const   call_metrics;
+	GPUGramSchmidt::RunStats call_stats;
+	call_stats.call_count = 1;
+
+	// 0. Without the GPU, the whole batch goes to the CPU
+	if ((this->backend != GPUGramSchmidt::Backend::gpu) && (!this->vk_ready))
+	{
+		if (this->backend != GPUGramSchmidt::Backend::cpu)
+			vgs::metrics_add_cpu_fallback();
+		auto const compute_start_time = std::chrono::steady_clock::now();
+		this->cpu_solver->run_batch(matrices, vectors_as_columns);
+		VGS_TRACE_HOST("cpu batch", compute_start_time);
+		call_stats.compute_time = seconds_since(compute_start_time);
+		add_matrices(call_stats, GPUGramSchmidt::Backend::cpu, matrices.size());
+		this->record(call_stats);
+		if (stats != nullptr)
+			*stats = call_stats;
+		return;
+	}
+	this->wait_until_ready();
+
+	// 1. Sort the matrices: tiny ones are grouped by order, the rest are either small enough for
+	//    the CPU or processed one by one
+	size_t const crossover_size = (this->backend == GPUGramSchmidt::Backend::gpu) ? (0) : (this->crossover_size.load());
+	std::map<size_t, std::vector<GPUGramSchmidt::Matrix *>> tiny_groups;
+	std::vector<GPUGramSchmidt::Matrix *> cpu_matrices;
+	std::vector<GPUGramSchmidt::Matrix *> large_matrices;
+	for (auto &matrix : matrices)
+		if ((matrix.size() >= vgs::min_fixed_dim) && (matrix.size() <= vgs::max_fixed_dim))
+			tiny_groups[matrix.size()].push_back(&matrix);
+		else if (matrix.size() < crossover_size)
+			cpu_matrices.push_back(&matrix);
+		else
+			large_matrices.push_back(&matrix);
+
+	// 2. A group of tiny matrices pays off on GPU if it has at least as much work as a matrix of
+	//    the crossover order. Without the fixed-size kernel, the group stays on the host: with the
+	//    CPU solver if there is one, and with the same unrolled code on this thread otherwise.
+	for (auto &tiny_group : tiny_groups)
+	{
+		double const dim = tiny_group.first;
+		if ((tiny_group.second.size() * dim * dim * dim >= static_cast<double>(crossover_size) * crossover_size * crossover_size) && (this->has_fixed_pipeline(tiny_group.first)))
+			this->run_fixed_batch(tiny_group.second, vectors_as_columns, &call_stats);
+		else if (this->cpu_solver != nullptr)
+			cpu_matrices.insert(cpu_matrices.end(), tiny_group.second.begin(), tiny_group.second.end());
+		else
+			this->run_fixed_batch_on_host(tiny_group.second, vectors_as_columns, &call_stats);
+	}
+
+	// 3. The CPU part is done as one batch; the matrices are moved there and back, not copied
+	if (!cpu_matrices.empty())
+	{
+		auto const compute_start_time = std::chrono::steady_clock::now();
+		std::vector<GPUGramSchmidt::Matrix> cpu_batch;
+		cpu_batch.reserve(cpu_matrices.size());
+		for (auto *const matrix : cpu_matrices)
+			cpu_batch.push_back(std::move(*matrix));
+		this->cpu_solver->run_batch(cpu_batch, vectors_as_columns);
+		for (size_t matrix_i = 0; matrix_i < cpu_matrices.size(); ++matrix_i)
+			*cpu_matrices[matrix_i] = std::move(cpu_batch[matrix_i]);
+		VGS_TRACE_HOST("cpu batch", compute_start_time);
+		call_stats.compute_time += seconds_since(compute_start_time);
+		add_matrices(call_stats, GPUGramSchmidt::Backend::cpu, cpu_matrices.size());
+	}
+
+	// 4. Large matrices are done one by one
+	for (auto *const matrix : large_matrices)
+		if (this->backend == GPUGramSchmidt::Backend::hybrid)
+			this->run_hybrid(*matrix, vectors_as_columns, &call_stats);
+		else
+			this->run_variant(*matrix, vectors_as_columns, this->variant, &call_stats);
+
+	this->record(call_stats);
+	if (stats != nullptr)
+		*stats = call_stats;
+	return;
+}
+
+
+
+
+
+void GPUGramSchmidt::run_fixed_batch(std::vector<GPUGramSchmidt::Matrix *> const &matrices, bool const vectors_as_columns, GPUGramSchmidt::RunStats *const stats)
+{
+	size_t const n            = matrices.front()->size();
+	size_t const matrix_count = matrices.size();
+	auto phase_start_time = std::chrono::steady_clock::now();
+
+	// 1. Make sure the pipeline and the memory are there
+	VkPipeline const vk_fixed_pipeline = this->get_fixed_pipeline(n);
+	this->reserve_matrix_memory(matrix_count * n * n * 8, stats);
+	double const allocation_time = seconds_since(phase_start_time);
+	VGS_TRACE_HOST("allocate", phase_start_time);
+	phase_start_time = std::chrono::steady_clock::now();
+
+	// 2. Fill the buffer with the matrices, one after another, on the NUMA node of the GPU
+	double *payload = nullptr;
+	VK_VALIDATE(  vkMapMemory(this->vk_device, this->vk_matrix_memory, 0, matrix_count * n * n * 8, 0, reinterpret_cast<void **>(&payload)), "Memory mapping before calculations failed."  );
+	this->on_gpu_node(matrix_count, [&](size_t const matrix_begin, size_t const matrix_end)
+	{
+		for (size_t matrix_i = matrix_begin; matrix_i < matrix_end; ++matrix_i)
+			for (size_t i = 0; i < n; ++i)
+				for (size_t j = 0; j < n; ++j)
+					payload[(matrix_i * n + i) * n + j] = vectors_as_columns ? (*matrices[matrix_i])[j][i] : (*matrices[matrix_i])[i][j];
+	});
+	vkUnmapMemory(this->vk_device, this->vk_matrix_memory);
+	double const upload_time = seconds_since(phase_start_time);
+	VGS_TRACE_HOST("pack", phase_start_time);
+	phase_start_time = std::chrono::steady_clock::now();
+
+	// 3. One invocation per matrix. A dispatch is limited in the number of work groups, so very
+	//    large batches take several; the push constants have the same layout as for the steps
+	//    of the main kernel.
+	GPUGramSchmidt::Variant const fixed_variant{.workgroup_size = fixed_workgroup_size};
+	size_t const max_dispatch_count = static_cast<size_t>(this->vk_physical_device_properties.limits.maxComputeWorkGroupCount[0]) * fixed_workgroup_size;
+	for (size_t first_matrix_i = 0; first_matrix_i < matrix_count; first_matrix_i += max_dispatch_count)
+	{
+		this->submit_step(vk_fixed_pipeline, fixed_variant, n, std::min(matrix_count, first_matrix_i + max_dispatch_count), first_matrix_i, stats);
+		this->wait_step(stats);
+	}
+	double const compute_time = seconds_since(phase_start_time);
+	VGS_TRACE_HOST("compute", phase_start_time);
+	phase_start_time = std::chrono::steady_clock::now();
+
+	// 4. Read the results into the original matrices
+	VK_VALIDATE(  vkMapMemory(this->vk_device, this->vk_matrix_memory, 0, matrix_count * n * n * 8, 0, reinterpret_cast<void **>(&payload)), "Memory mapping after calculations failed."  );
+	this->on_gpu_node(matrix_count, [&](size_t const matrix_begin, size_t const matrix_end)
+	{
+		for (size_t matrix_i = matrix_begin; matrix_i < matrix_end; ++matrix_i)
+			for (size_t i = 0; i < n; ++i)
+				for (size_t j = 0; j < n; ++j)
+					(*matrices[matrix_i])[vectors_as_columns ? j : i][vectors_as_columns ? i : j] = payload[(matrix_i * n + i) * n + j];
+	});
+	vkUnmapMemory(this->vk_device, this->vk_matrix_memory);
+	VGS_TRACE_HOST("unpack", phase_start_time);
+
+	if (stats != nullptr)
+	{
+		add_gpu_phases(*stats, allocation_time, upload_time, compute_time, seconds_since(phase_start_time), matrix_count * n * n * 8);
+		add_matrices(*stats, GPUGramSchmidt::Backend::gpu, matrix_count);
+		stats->memory_type = this->vk_matrix_memory_type;
+		stats->variant     = fixed_variant;
+	}
+	return;
+}
+
+
+
+
+
+void GPUGramSchmidt::run_fixed_batch_on_host(std::vector<GPUGramSchmidt::Matrix *> const &matrices, bool const vectors_as_columns, GPUGramSchmidt::RunStats *const stats)
+{
+	size_t const n = matrices.front()->size();
+	auto const compute_start_time = std::chrono::steady_clock::now();
+	double vectors[vgs::max_fixed_dim * vgs::max_fixed_dim];
+	for (auto *const matrix : matrices)
+	{
+		for (size_t vec_i = 0; vec_i < n; ++vec_i)
+			for (size_t dim_i = 0; dim_i < n; ++dim_i)
+				vectors[vec_i * n + dim_i] = vectors_as_columns ? (*matrix)[dim_i][vec_i] : (*matrix)[vec_i][dim_i];
+		vgs::orthonormalise_fixed(vectors, n);
+		for (size_t vec_i = 0; vec_i < n; ++vec_i)
+			for (size_t dim_i = 0; dim_i < n; ++dim_i)
+				(vectors_as_columns ? (*matrix)[dim_i][vec_i] : (*matrix)[vec_i][dim_i]) = vectors[vec_i * n + dim_i];
+	}
+	VGS_TRACE_HOST("cpu batch", compute_start_time);
+	if (stats != nullptr)
+	{
+		stats->compute_time += seconds_since(compute_start_time);
+		add_matrices(*stats, GPUGramSchmidt::Backend::cpu, matrices.size());
+	}
+	return;
+}
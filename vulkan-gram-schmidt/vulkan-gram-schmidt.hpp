@@ -9,10 +9,19 @@
 
 
 
+#include "cpu-gram-schmidt.hpp"
+#include "lapack-gram-schmidt.hpp"
+#include "numa.hpp"
+#include "fixed-gram-schmidt.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
 #include <vulkan/vulkan.hpp>
 #include <vector>
 #include <map>
 #include <mutex>
+#include <atomic>
+#include <future>
+#include <memory>
 
 
 
@@ -32,6 +41,9 @@
  * * Matrices passed to the GPUGramSchmidt::run function are required to be non-singular; otherwise,
  *   no guarantees are given about the behaviour of the program.
  * 
+ * If no suitable GPU is found, the solver may fall back to CPUGramSchmidt (see
+ * GPUGramSchmidt::Backend), so that the same code works on machines without a GPU.
+ * 
  * Instances of this class are generally expected to be thread-secure, however, this was not
  * heavily tested.
  */
@@ -40,6 +52,105 @@ class GPUGramSchmidt final
 
 
 
+public:
+
+	using Matrix = std::vector<std::vector<double>>;
+
+	/**
+	 * @brief Device that does the computations
+	 */
+	enum class Backend : uint8_t
+	{
+		automatic, ///< GPU if there is a suitable one (and it is set up), CPU otherwise
+		gpu,       ///< GPU only; the lack of a suitable GPU is an error
+		cpu,       ///< CPU only; Vulkan is not touched at all
+		hybrid     ///< Same as @c automatic, but large matrices are split between GPU and CPU that work simultaneously
+	};
+
+	/**
+	 * @brief Compute kernel variant
+	 *
+	 * Describes the specialisation of the compute shader that is used to process a matrix.
+	 * Each distinct variant gets its own compute pipeline which is created on the first use
+	 * (or beforehand by GPUGramSchmidt::warm_up).
+	 */
+	struct Variant
+	{
+		/// Number of invocations in one work group (@c constant_id = 0 of the shader)
+		uint32_t workgroup_size = 32;
+	};
+
+	/**
+	 * @brief Statistics of one call to GPUGramSchmidt::run or GPUGramSchmidt::run_batch
+	 *
+	 * Times are split into phases. On CPU, packing and unpacking of the vectors are part of the
+	 * computations, so only @c compute_time is filled. The difference between @c compute_time and
+	 * @c gpu_compute_time is the host overhead of recording, submitting and waiting. For a batch,
+	 * times and counters are summed over the matrices.
+	 */
+	struct RunStats
+	{
+		Backend  backend          = Backend::cpu; ///< Device that did the computations: Backend::gpu, Backend::cpu or Backend::hybrid (also if a batch was split between the devices)
+		uint64_t call_count       = 0;            ///< Number of calls (1 for a single call)
+		uint64_t matrix_count     = 0;            ///< Number of matrices processed
+		double   allocation_time  = 0.0;          ///< Preparation of the pipeline and of the device memory, seconds
+		double   upload_time      = 0.0;          ///< Copying of the matrix into the device memory, seconds
+		double   compute_time     = 0.0;          ///< Gram-Schmidt process itself, seconds
+		double   download_time    = 0.0;          ///< Copying of the answer back into the matrix, seconds
+		double   gpu_compute_time = 0.0;          ///< Execution of the dispatches measured by GPU timestamps, seconds (0 unless GPUGramSchmidt::set_gpu_timing is on)
+		double   fence_wait_time  = 0.0;          ///< Waiting for the GPU to finish the submitted work, seconds (part of @c compute_time)
+		uint64_t bytes_uploaded   = 0;            ///< Bytes written into the device memory
+		uint64_t bytes_downloaded = 0;            ///< Bytes read from the device memory
+		uint32_t allocation_count = 0;            ///< Number of Vulkan memory allocations
+		uint32_t submit_count     = 0;            ///< Number of queue submissions
+		uint32_t dispatch_count   = 0;            ///< Number of compute dispatches
+		int32_t  memory_type      = -1;           ///< Index of the Vulkan memory type of the device memory, -1 if the GPU was not used
+		Variant  variant;                         ///< Kernel variant used on GPU (the fixed-size kernel for batches of tiny matrices)
+	};
+
+	/**
+	 * @brief Device memory in use, see GPUGramSchmidt::get_device_memory_usage
+	 */
+	struct DeviceMemoryUsage
+	{
+		uint64_t matrix_buffer = 0; ///< Size of the matrix buffer of this solver, bytes
+		uint64_t heap_usage    = 0; ///< Device memory used by the whole process, summed over the heaps, bytes (0 without @c VK_EXT_memory_budget)
+		uint64_t heap_budget   = 0; ///< Device memory the process may use, summed over the heaps, bytes (0 without @c VK_EXT_memory_budget)
+	};
+
+	/**
+	 * @brief Throughput limits of the GPU, see GPUGramSchmidt::measure_device_limits
+	 */
+	struct DeviceLimits
+	{
+		double fp64_flops = 0.0; ///< Peak rate of double-precision arithmetic, FLOP/s (a fused multiply-add is 2 operations)
+		double bandwidth  = 0.0; ///< Peak bandwidth of the memory the matrices are kept in, bytes per second
+	};
+
+	/**
+	 * @brief One statistic of a pipeline executable, as named by the driver
+	 */
+	struct PipelineStatistic
+	{
+		std::string name;        ///< E.g. "VGPRs", "Spilled VGPRs" or "LDS size" on RADV
+		std::string description;
+		double      value = 0.0; ///< Booleans are 0 or 1
+	};
+
+	/**
+	 * @brief Statistics of one executable the driver compiled a pipeline into, see
+	 * GPUGramSchmidt::get_pipeline_statistics
+	 */
+	struct PipelineExecutable
+	{
+		std::string                    name;
+		std::string                    description;
+		uint32_t                       subgroup_size = 0;
+		std::vector<PipelineStatistic> statistics;
+	};
+
+
+
 private:
 
 	VkInstance            vk_instance;
@@ -47,14 +158,35 @@ private:
 	VkDevice              vk_device;
 	std::vector<VkQueue>  vk_queues;
 	VkShaderModule        vk_compute_shader;
+	VkShaderModule        vk_fixed_shader;    // loaded on the first use
+	VkShaderModule        vk_probe_shader;    // loaded on the first use
+	bool                  vk_fixed_missing;   // whether the fixed-size kernel failed to load, so tiny matrices stay on the host
 	VkDescriptorSetLayout vk_descriptor_set_0_layout;
 	VkPipelineLayout      vk_compute_pipeline_layout;
-	VkPipeline            vk_compute_pipeline;
 	VkCommandPool         vk_command_pool;
 	VkCommandBuffer       vk_command_buffer;
 	VkDescriptorPool      vk_descriptor_pool;
 	VkDescriptorSet       vk_descriptor_set_0;
 	VkFence               vk_fence;
+	VkQueryPool           vk_timestamp_pool;  // null if the queue cannot write timestamps
+	uint64_t              vk_timestamp_mask;  // valid bits of a timestamp
+	bool                  vk_step_timed;      // whether the last submitted step writes timestamps
+	bool                  vk_memory_budget;   // whether VK_EXT_memory_budget is enabled
+	VkBuffer              vk_matrix_buffer;
+	VkDeviceMemory        vk_matrix_memory;
+	VkDeviceSize          vk_matrix_capacity;
+	int32_t               vk_matrix_memory_type; // index of the memory type of vk_matrix_memory, -1 if none
+	int32_t               vk_numa_node;       // NUMA node the GPU is attached to, -1 if unknown
+
+	PFN_vkGetCalibratedTimestampsEXT         vk_get_calibrated_timestamps; // null unless tracing with VK_EXT_calibrated_timestamps
+	PFN_vkGetPipelineExecutablePropertiesKHR vk_get_executable_properties; // null without VK_KHR_pipeline_executable_properties
+	PFN_vkGetPipelineExecutableStatisticsKHR vk_get_executable_statistics; // null without VK_KHR_pipeline_executable_properties
+
+	VkPhysicalDeviceProperties     vk_physical_device_properties;
+	std::map<uint32_t, VkPipeline> vk_compute_pipelines; // by work group size
+	std::map<uint32_t, VkPipeline> vk_fixed_pipelines;   // by matrix order
+	std::map<uint32_t, VkPipeline> vk_probe_pipelines;   // by probe mode
+	Variant                        variant;
 
 	uint32_t vk_selected_gpu_i;
 	uint32_t vk_selected_queue_family_i;
@@ -64,20 +196,225 @@ private:
 
 	static std::mutex constructor;
 
+	/// Crossover order and rates measured for one GPU, driver and CPU thread count
+	struct Profile
+	{
+		size_t crossover_size;
+		double cpu_flops;
+		double gpu_step_time;
+	};
 
+	static std::map<std::string, Profile> profiles;
+	static std::mutex                     profiles_lock;
+
+	std::shared_future<void> vk_initialisation;
+	std::atomic<bool>        vk_ready;
+	std::atomic<bool>        gpu_timing;
+
+	Backend                          backend;
+	std::unique_ptr<CPUGramSchmidt>  cpu_solver;
+	std::unique_ptr<vgs::ThreadPool> numa_pool;     // workers bound to vk_numa_node, null on single-node machines
+	std::atomic<size_t>              crossover_size;
+	double                           cpu_flops;     // measured rate of CPU projections
+	double                           gpu_step_time; // measured duration of one GPU step
+	uint32_t                         trace_track;   // track of the GPU ranges of this solver in the trace
+
+	mutable std::mutex total_stats_lock; // protects total_stats
+	RunStats           total_stats;
+
+	/**
+	 * @brief Sets up the Vulkan environment
+	 *
+	 * Does the actual work of the constructor; may be executed in a background thread.
+	 */
+	void initialise(bool const enable_debug);
+
+	/**
+	 * @brief Same as GPUGramSchmidt::initialise, but cleans up if the setup fails
+	 */
+	void initialise_or_release(bool const enable_debug);
+
+	/**
+	 * @brief Destroys all Vulkan objects that have been created so far
+	 */
+	void release(void);
+
+	/**
+	 * @brief Waits for the background initialisation
+	 *
+	 * Unlike GPUGramSchmidt::wait_until_ready, rethrows setup errors only if the GPU
+	 * was requested explicitly.
+	 * 
+	 * @return @c true if the GPU is ready to be used.
+	 */
+	bool await_gpu(void) const;
+
+	/**
+	 * @brief Identifies the GPU, its driver and the number of CPU threads in a profile
+	 */
+	std::string get_profile_key(void) const;
+
+	/**
+	 * @brief Takes the crossover order from an earlier measurement in this process or from
+	 * GPUGramSchmidt::profile_path; measures it only if the profile file lacks it
+	 */
+	void load_or_calibrate(void);
+
+	/**
+	 * @brief Measures the crossover order; the GPU must be set up
+	 */
+	void calibrate_unchecked(void);
+
+	/**
+	 * @brief Whether the backend routes matrices between CPU and GPU
+	 */
+	bool uses_routing(void) const;
+
+	/**
+	 * @brief Records and submits one step of the process: vector @c start_vec_i is normalised and
+	 * removed from the vectors up to @c vector_count
+	 *
+	 * The step is timed on GPU if @c stats is given and the GPU timing is on, and always when
+	 * tracing.
+	 */
+	void submit_step(VkPipeline const vk_compute_pipeline, Variant const &variant, uint32_t const dim, uint32_t const vector_count, uint32_t const start_vec_i, RunStats *const stats);
+
+	/**
+	 * @brief Processes rows of the buffer shared with the GPU on the NUMA node of the GPU
+	 *
+	 * Calls `body(row_begin, row_end)` for chunks of \f$[0, row\_count)\f$ on the workers of
+	 * GPUGramSchmidt::numa_pool, so that pages first touched by @c body are placed on that node;
+	 * on the calling thread if there is no such pool. @c body must not throw.
+	 */
+	void on_gpu_node(size_t const row_count, std::function<void(size_t, size_t)> const &body);
+
+	/**
+	 * @brief Waits for the step submitted by GPUGramSchmidt::submit_step
+	 *
+	 * Throws if the step takes longer than GPUGramSchmidt::step_timeout.
+	 */
+	void wait_step(RunStats *const stats);
+
+	/**
+	 * @brief Runs Gram-Schmidt process on GPU and CPU simultaneously
+	 *
+	 * Adds its statistics to @c stats, if given (and so do the other internal computations).
+	 */
+	void run_hybrid(Matrix &matrix, bool const vectors_as_columns, RunStats *const stats = nullptr);
+
+	/**
+	 * @brief Creates a compute pipeline for the given kernel variant
+	 */
+	VkPipeline create_compute_pipeline(Variant const &variant, VkPipelineCreateFlags const vk_flags = 0);
+
+	/**
+	 * @brief Returns the compute pipeline for the given kernel variant, creating it if needed
+	 */
+	VkPipeline get_compute_pipeline(Variant const &variant);
+
+	/**
+	 * @brief Loads a SPIR-V shader from GPUGramSchmidt::shader_folder
+	 */
+	VkShaderModule load_shader(std::string const &file_name);
+
+	/**
+	 * @brief Creates a compute pipeline for a shader with the given value of its @c constant_id = 1
+	 * (the work group size keeps its default)
+	 */
+	VkPipeline create_specialised_pipeline(VkShaderModule const vk_shader, uint32_t const constant_1);
+
+	/**
+	 * @brief Returns the compute pipeline of the fixed-size kernel for the given matrix order,
+	 * creating it (and loading the shader) if needed
+	 */
+	VkPipeline get_fixed_pipeline(uint32_t const dim);
+
+	/**
+	 * @brief Whether the fixed-size kernel for the given matrix order can be used
+	 *
+	 * A shader that cannot be loaded is not looked for again.
+	 */
+	bool has_fixed_pipeline(uint32_t const dim);
+
+	/**
+	 * @brief Returns the compute pipeline of the probe kernel for the given mode (0 for arithmetic,
+	 * 1 for memory), creating it (and loading the shader) if needed
+	 */
+	VkPipeline get_probe_pipeline(uint32_t const mode);
+
+	/**
+	 * @brief Times the probe kernel with as many passes as needed to run for a while
+	 *
+	 * @return Best of a few runs: passes done and seconds taken.
+	 */
+	std::pair<uint32_t, double> time_probe(uint32_t const mode, uint32_t const invocation_count);
+
+	/**
+	 * @brief Makes sure the matrix buffer can hold at least @c byte_count bytes
+	 *
+	 * The buffer only grows; it is reused by all subsequent computations.
+	 */
+	void reserve_matrix_memory(VkDeviceSize const byte_count, RunStats *const stats = nullptr);
+
+	/**
+	 * @brief Runs Gram-Schmidt process with the given kernel variant
+	 */
+	void run_variant(Matrix &matrix, bool const vectors_as_columns, Variant const &variant, RunStats *const stats = nullptr);
+
+	/**
+	 * @brief Runs Gram-Schmidt process on GPU for a batch of tiny matrices of the same order,
+	 * one matrix per invocation
+	 */
+	void run_fixed_batch(std::vector<Matrix *> const &matrices, bool const vectors_as_columns, RunStats *const stats = nullptr);
+
+	/**
+	 * @brief Runs Gram-Schmidt process on the host for a batch of tiny matrices, one after another
+	 *
+	 * Used when the fixed-size kernel is not available and there is no CPU solver.
+	 */
+	void run_fixed_batch_on_host(std::vector<Matrix *> const &matrices, bool const vectors_as_columns, RunStats *const stats = nullptr);
+
+	/**
+	 * @brief Adds the statistics of a call to the totals
+	 *
+	 * Counters and times are summed. @c backend, @c memory_type and @c variant are overwritten,
+	 * so in the totals they describe the last call only.
+	 */
+	void record(RunStats const &call_stats);
 
-public:
 
-	using Matrix = std::vector<std::vector<double>>;
+
+public:
 
 	/// @name Static parameters
 	/// @{
 	
 	/**
-	 * Path to a folder containing "vulkan-gram-schmidt.spv"
+	 * Path to a folder containing "vulkan-gram-schmidt.spv" (and "vulkan-gram-schmidt-fixed.spv"
+	 * for GPUGramSchmidt::run_batch)
 	 */
 	static std::string shader_folder;
 
+	/**
+	 * Path to a text file that caches the CPU/GPU crossover order for each GPU (see
+	 * GPUGramSchmidt::calibrate). If set, solvers with `Backend::automatic` or `Backend::hybrid`
+	 * measure it on setup when the file lacks it; empty means that it is only measured on request
+	 */
+	static std::string profile_path;
+
+	/**
+	 * Crossover order used until one is measured or loaded from GPUGramSchmidt::profile_path.
+	 * Errs on the side of the GPU: below it, a CPU thread usually finishes before a single Vulkan
+	 * submission returns
+	 */
+	static size_t default_crossover_size;
+
+	/**
+	 * Seconds a single GPU step may take before the GPU is considered hung; the call then throws,
+	 * and the solver falls back to the CPU (or throws, with `Backend::gpu`) from then on
+	 */
+	static double step_timeout;
+
 	/// @}
 
 	/// @name Constructors & destructors
@@ -89,11 +426,21 @@ public:
 	 * Sets up a Vulkan communication environment with the GPU.
 	 * 
 	 * @param enable_debug Send Vulkan debug information to the output.
+	 * @param asynchronous_init Return immediately and set up the Vulkan environment in a background
+	 *                          thread. The first call to GPUGramSchmidt::run will wait until the
+	 *                          setup is over (with `backend = Backend::gpu`) or will be computed
+	 *                          on CPU (otherwise).
+	 * @param backend Device that does the computations. With `Backend::automatic`, failure to
+	 *                set up the GPU is not an error; the CPU is used instead.
 	 * 
 	 * @warning `enable_debug = true` will require the presence of the @c VK_LAYER_KHRONOS_validation
 	 * Vulkan layer and the @c VK_EXT_debug_utils Vulkan extension.
+	 * 
+	 * @warning If `asynchronous_init = true`, errors of the setup are not thrown by the constructor;
+	 * they are rethrown by GPUGramSchmidt::wait_until_ready (and by GPUGramSchmidt::run if
+	 * `backend = Backend::gpu`) instead.
 	 */
-	GPUGramSchmidt(bool const enable_debug = false);
+	GPUGramSchmidt(bool const enable_debug = false, bool const asynchronous_init = false, Backend const backend = Backend::automatic);
 
 	/**
 	 * @brief Destroys the solver
@@ -106,17 +453,206 @@ public:
 
 
 
+	/// @name Initialisation
+	/// @{
+
+	/**
+	 * @brief Check whether the solver is set up
+	 *
+	 * @return @c true if the Vulkan environment has been successfully set up, @c false if the
+	 * background initialisation is still in progress or has failed.
+	 */
+	bool is_ready(void) const;
+
+	/**
+	 * @brief Wait for the background initialisation
+	 *
+	 * Blocks until the Vulkan environment is set up. Does nothing if the solver was
+	 * constructed with `asynchronous_init = false`.
+	 *
+	 * @throw std::runtime_error If the background initialisation has failed, or if a GPU step has
+	 * exceeded GPUGramSchmidt::step_timeout.
+	 */
+	void wait_until_ready(void) const;
+
+	/**
+	 * @brief Get the device that does the computations right now
+	 *
+	 * @return Backend::gpu or Backend::cpu. With `Backend::automatic`, the answer may change from
+	 * Backend::cpu to Backend::gpu once the background initialisation is over.
+	 */
+	Backend get_backend(void) const;
+
+	/**
+	 * @brief Get the name of the GPU
+	 *
+	 * @return Name reported by the driver, empty if the GPU is not set up.
+	 */
+	std::string get_device_name(void) const;
+
+	/**
+	 * @brief Prepare the solver for the steady state
+	 *
+	 * Creates compute pipelines for all the given kernel variants, allocates device memory
+	 * enough for the largest of the given matrix orders and pushes a tiny workload through
+	 * each variant. This way, none of these costs is paid by the first calls to
+	 * GPUGramSchmidt::run.
+	 * 
+	 * @param sizes Expected orders of the matrices.
+	 * @param variants Kernel variants that will be used.
+	 */
+	void warm_up(std::vector<size_t> const &sizes, std::vector<Variant> const &variants);
+
+	/**
+	 * @brief Prepare the solver for the steady state
+	 *
+	 * Same as above for the currently selected kernel variant only.
+	 */
+	void warm_up(std::vector<size_t> const &sizes);
+
+	/// @}
+
+
+
+	/// @name CPU/GPU routing
+	/// @{
+
+	/**
+	 * @brief Measure the CPU/GPU crossover order
+	 *
+	 * Times both backends on matrices of orders 2, 4, 8, ..., 512 and sets the crossover order to
+	 * the one from which on the GPU is faster. With `Backend::automatic`, smaller matrices are then
+	 * sent to the CPU by GPUGramSchmidt::run.
+	 * 
+	 * The result is shared by all solvers on the same GPU in this process. Without a measurement,
+	 * the crossover order is GPUGramSchmidt::default_crossover_size. Does nothing for other backends.
+	 */
+	void calibrate(void);
+
+	/**
+	 * @brief Get the CPU/GPU crossover order
+	 *
+	 * @return Order from which on matrices are sent to the GPU.
+	 */
+	size_t get_crossover_size(void) const;
+
+	/**
+	 * @brief Override the CPU/GPU crossover order
+	 */
+	void set_crossover_size(size_t const crossover_size);
+
+	/// @}
+
+
+
+	/// @name Profiling
+	/// @{
+
+	/**
+	 * @brief Switch the GPU timing on or off
+	 *
+	 * When on, each dispatch is surrounded by GPU timestamps, and GPUGramSchmidt::RunStats::gpu_compute_time
+	 * receives the time the GPU actually spent on the computations. When off (the default),
+	 * nothing is recorded and nothing is read back.
+	 */
+	void set_gpu_timing(bool const enable);
+
+	/**
+	 * @brief Check whether GPU timestamps are recorded
+	 *
+	 * @return @c true if the GPU timing is on and the GPU is able to write timestamps from its
+	 * compute queue.
+	 */
+	bool get_gpu_timing(void) const;
+
+	/**
+	 * @brief Get the device memory in use
+	 *
+	 * The matrix buffer is reported always; the usage and the budget of the device heaps only if
+	 * the driver supports @c VK_EXT_memory_budget. They cover the whole process, not just this
+	 * solver. Everything is 0 if the GPU is not set up.
+	 */
+	DeviceMemoryUsage get_device_memory_usage(void) const;
+
+	/**
+	 * @brief Get the statistics of all the calls so far
+	 *
+	 * @return Sums of the statistics of all calls to GPUGramSchmidt::run and GPUGramSchmidt::run_batch
+	 * since the construction (or GPUGramSchmidt::reset_total_stats). @c backend, @c memory_type and
+	 * @c variant are those of the last call.
+	 */
+	RunStats get_total_stats(void) const;
+
+	/**
+	 * @brief Forget the statistics of the calls so far
+	 */
+	void reset_total_stats(void);
+
+	/**
+	 * @brief Measure the peak throughput of the GPU
+	 *
+	 * Vulkan reports neither clocks nor bandwidth, so both are measured by the probe kernels of
+	 * "vulkan-gram-schmidt-probe.spv" (see GPUGramSchmidt::shader_folder): chains of
+	 * double-precision fused multiply-adds, and copies through the same kind of memory the
+	 * matrices are kept in. Takes a fraction of a second; the matrix buffer grows to 64 MiB.
+	 *
+	 * @throw std::runtime_error If the GPU is not set up.
+	 */
+	DeviceLimits measure_device_limits(void);
+
+	/// @}
+
+
+
+	/// @name Kernel variants
+	/// @{
+
+	/**
+	 * @brief Select the kernel variant used by GPUGramSchmidt::run
+	 *
+	 * The pipeline for the variant is created right away.
+	 *
+	 * @throw std::runtime_error If the GPU cannot run the variant.
+	 */
+	void set_variant(Variant const &variant);
+
+	/**
+	 * @brief Get the kernel variant used by GPUGramSchmidt::run
+	 */
+	Variant get_variant(void) const;
+
+	/**
+	 * @brief Get what the driver compiled the given kernel variant into
+	 *
+	 * The variant is compiled once more with @c VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR, and
+	 * its statistics are read through @c VK_KHR_pipeline_executable_properties: register usage,
+	 * spills, shared memory and whatever else the driver reports. They help to judge occupancy
+	 * when tuning the work group size. The pipelines used for the computations are not affected.
+	 *
+	 * @return One entry per executable of the pipeline; empty if the driver does not support the
+	 * extension.
+	 *
+	 * @throw std::runtime_error If the GPU is not set up or cannot run the variant.
+	 */
+	std::vector<PipelineExecutable> get_pipeline_statistics(Variant const &variant);
+
+	/// @}
+
+
+
 	/// @name Computations
 	/// @{
 	
 	/**
 	 * @brief Run Gram-Schmidt process on GPU
 	 *
-	 * Perform orthonormalisation of vectors with the help of GPU.
+	 * Perform orthonormalisation of vectors with the help of GPU (or CPU, see
+	 * GPUGramSchmidt::get_backend).
 	 * 
 	 * @param matrix Square matrix with the coordinates of the original vectors.
 	 * @param vectors_as_columns Indicates whether vectors are packed into @c matrix
 	 *                           as columns or as rows.
+	 * @param stats If not null, receives the statistics of the call.
 	 * 
 	 * @warning Keep in mind, that the non-singularity of @c matrix must be guaranteed
 	 * by you.
@@ -124,7 +660,29 @@ public:
 	 * @return Nothing; the answer is written directly into @c matrix. If `vectors_as_columns == true`,
 	 * the answer will also be written in columns.
 	 */
-	void run(GPUGramSchmidt::Matrix &matrix, bool const vectors_as_columns=false);
+	void run(GPUGramSchmidt::Matrix &matrix, bool const vectors_as_columns=false, RunStats *const stats=nullptr);
+
+	/**
+	 * @brief Run Gram-Schmidt process for a batch of matrices
+	 *
+	 * Matrices may be of different orders. Matrices of orders 2 to 16 are grouped by order, and
+	 * each group is processed on GPU by one dispatch of a kernel specialised for that order, with
+	 * one matrix per invocation. Groups too small to pay off the GPU overhead (see
+	 * GPUGramSchmidt::get_crossover_size) and other matrices below the crossover order are
+	 * processed by CPUGramSchmidt::run_batch; the rest are processed one by one as by
+	 * GPUGramSchmidt::run.
+	 * 
+	 * @param matrices Square matrices with the coordinates of the original vectors.
+	 * @param vectors_as_columns Indicates whether vectors are packed into @c matrices
+	 *                           as columns or as rows.
+	 * @param stats If not null, receives the statistics of the call, summed over the matrices.
+	 * 
+	 * @warning Keep in mind, that the non-singularity of all @c matrices must be guaranteed
+	 * by you.
+	 * 
+	 * @return Nothing; the answers are written directly into @c matrices.
+	 */
+	void run_batch(std::vector<GPUGramSchmidt::Matrix> &matrices, bool const vectors_as_columns=false, RunStats *const stats=nullptr);
 
 	/// @}
 